@@ -3,19 +3,41 @@
 #include <future>
 #include <ctime>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <climits>
 #include <vector>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <chrono>
+#include <memory>
 #include "PerlinNoise.hpp"
 
 using namespace std;
 using namespace sf;
 
-// Char identifiers for entities on screen
-// (These chars are stored in the blueprints array, so that we can keep track of everyone's position)
-char waterCharIdentifier = 'w';
-char landCharIdentifier = 'l';
-char rabbitCharIdentifier = 'r';
-char plantCharIdentifier = 'p';
-char wolfCharIdentifier = 'W';
+// Layer identifiers for entities on screen
+// (Each layer owns one bit of every cell in the blueprint grid, so that we can keep track of everyone's position)
+enum BlueprintLayer
+{
+    landLayer,
+    waterLayer,
+    plantLayer,
+    rabbitLayer,
+    wolfLayer
+};
+
+// Land and water never move, everything from this layer onwards can stack on a pixel and is counted
+const int firstOccupantLayer = plantLayer;
+const int numOccupantLayers = wolfLayer - firstOccupantLayer + 1;
 
 // Setting global variables
 const int height = 1080 / 2;
@@ -66,6 +88,13 @@ float plantDensity = 4;
 float plantSize = 5;
 int numPlants = floor((width * height) * plantDensity);
 
+// Biomass of a fully grown plant. A rabbit eats plantBite of it at a time, a plant with less than
+// plantEdibleBiomass left is not food until it has grown back, and plants grow plantRegrowth every tick.
+int maxPlantBiomass = 100;
+int plantBite = 40;
+int plantEdibleBiomass = 30;
+int plantRegrowth = 1;
+
 // -------- COLOR VARIABLES ----------
 // These store rgba values for colors used
 int landColorRGBA[4] = {(int)(255 * 3.1 / 100), (int)(255 * 64.7 / 100), (int)(255 * 9.0 / 100), 255};
@@ -73,1107 +102,4087 @@ int waterColorRGBA[4] = {(int)(255 * 11.0 / 100), (int)(255 * 29.0 / 100), (int)
 int treeColorRGBA[4] = {(int)(255 * 0.0 / 100), (int)(255 * 42.0 / 100), (int)(255 * 15.7 / 100), 255};
 
 // -------- OTHER VARIABLES ----------
+// Slowest the window is allowed to draw at: ticks owed past one frame's worth of time are skipped
 int frameRate = 30;
 
-const float pi = 3.142;
+// Simulation ticks per second at 1x speed, no matter how often the window draws
+int ticksPerSecond = 30;
 
-class Rabbit;
-class Plant;
-class Wolf;
+// Speeds the simulation can run at (- and + step through them), as multiples of ticksPerSecond
+int simulationSpeeds[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+int numSimulationSpeeds = sizeof(simulationSpeeds) / sizeof(simulationSpeeds[0]);
+int speedLevel = 0;
 
-// Vector arrays to store objects
-vector<Rabbit *> rabbits;
-vector<Plant *> plants;
-vector<Wolf *> wolves;
+// How far (0 to 1) the simulation is into the next tick, animals are drawn that far along their last move
+float tickFraction = 1;
 
-// Objects for terrain generation and display
-Image terrainTextureImage;
-Texture terrainTexture;
-Sprite backgroundSprite;
+// Pixels the camera moves per frame while an arrow key (or WASD) is held
+float cameraSpeed = 8;
 
-// The POSITION BLUEPRINT
-// Array that holds the position data for entities
-vector<char> positionBlueprint[width][height];
+// Random points roam tries around an animal before it falls back to its region's list of land pixels
+int roamAttempts = 16;
 
-// Boolean that is false until terrain is generated
-bool terrainGenerated = false;
+// When true (--headless) nothing is ever drawn, so no window, textures or sprites are created
+bool headless = false;
 
-// Some Function headers
-bool isLand(int x, int y);
-bool isWithinBounds(int x, int y);
-void addToPositionBlueprint(char charIdentifier, int x, int y);
-bool checkPositionInBlueprint(char charIdentifier, int x, int y);
-void removePositionFromBlueprint(char charIdentifier, int x, int y);
-void removePlant(Vector2f position);
-void addRabbit(Vector2f position);
-void removeRabbit(Vector2f position);
-void addWolf(Vector2f position);
-void removeWolf(Vector2f position);
+// Number of ticks to simulate in headless mode (--ticks N)
+int headlessTicks = 1000;
 
-// ----------------- CLASSES ------------------
+// Number of threads animals are updated on (--threads N)
+int numThreads = max(1, (int)thread::hardware_concurrency());
 
-class Animal
-{
-protected:
-    Sprite shape; // SFML Shape object for the animal
-    Texture animalTexture;
-    float speed;                 // Speed of the animal
-    Vector2f direction;          // Direction the animal is headed
-    Vector2f position;           // Current position of the animal
-    Vector2f headedTo;           // Direction the animal is headed when roaming randomly
-    Vector2f closestFoodSource;  // Stores the location of closest food source for the animal
-    Vector2f closestWaterSource; // Stores the location of closest water source for the animal
-    Vector2f closestMate;        // Stored the location of the closest mate for the animal
-    float maxHunger;             // Max hunger that the animal can live with
-    float maxThirst;             // Max thirst that the animal can live with
-    float maxReproductiveUrge;   // Max reproductive urge
-    float hungerLevel;           // Current hunger level of the animal
-    float thirstLevel;           // Current thirst level of the animal
-    float reproductiveUrge;      // Current reproductive urge of the animal
-
-    friend void initializeRabbits(RenderWindow *window);
+// Every random number of a run comes from this seed (--seed N, the time by default)
+uint64_t worldSeed = 0;
 
-public:
-    Animal(
-        float speed,
-        Vector2f direction,
-        Vector2f position,
-        float maxHunger,
-        float maxThirst,
-        float maxReproductiveUrge)
-        : speed(speed),
-          direction(direction),
-          position(position),
-          maxHunger(maxHunger),
-          maxThirst(maxThirst),
-          maxReproductiveUrge(maxReproductiveUrge),
-          closestFoodSource(Vector2f(-1, -1)),
-          closestWaterSource(Vector2f(-1, -1)),
-          closestMate(Vector2f(-1, -1))
-    {
-        // Setting the shape origin to center
-        shape.setOrigin(shape.getGlobalBounds().width / 2, shape.getGlobalBounds().height / 2);
-
-        shape.setPosition(floor(position.x), floor(position.y));
+// Snapshot to start from instead of a new world (--load FILE), and where snapshots are saved
+// (--save FILE, at the end of a headless run or when F5 is pressed)
+string loadPath;
+string savePath;
 
-        // Setting the initial headed to to a valid value so that it doesnt break
-        headedTo = position;
-    }
+const float pi = 3.142;
+
+// Size of the world in pixels (--world W H). It can be much larger than the window, which only
+// shows the part of it under the camera
+int worldWidth = width;
+int worldHeight = height;
+
+// Pixels are numbered y * world width + x in 32 bits (plant handles, snapshots), which caps the world's
+// area (the last number is the invalid handle slot)
+const long long maxWorldPixels = (1ll << 32) - 1;
+
+// Whether a world of this size can be simulated: never smaller than the window, and within maxWorldPixels
+bool isValidWorldSize(long long w, long long h)
+{
+    return w >= width && h >= height && w * h <= maxWorldPixels;
+}
 
-    virtual void draw(RenderWindow *window) = 0; // virtual function
+View camera(FloatRect(0, 0, width, height));
+
+// Rabbits and wolves come from one shared texture atlas (see buildTextureAtlas), and each kind
+// is drawn in one go from its own vertex array (a textured quad per entity). Plants are painted
+// straight into the terrain textures.
+Texture atlasTexture;
+IntRect rabbitAtlasRect;
+IntRect wolfAtlasRect;
+VertexArray rabbitVertices(Quads);
+VertexArray wolfVertices(Quads);
+
+// The WORLD is split into square CHUNKS. A chunk is generated from the terrain seed the first time
+// something needs it, and may be evicted again once nothing has needed it for a while, so memory
+// follows the area that is being simulated or watched rather than the size of the world.
+const int chunkSize = 64;
+
+// Idle chunks are only evicted while more than this many are loaded (each one is about 90 KB)
+const int maxLoadedChunks = 512;
+
+// A chunk counts as idle once it has not been needed for this many ticks
+const int chunkEvictTicks = 150;
+
+// The SPATIAL INDEX
+// Plants, rabbits and wolves are also bucketed into square cells of the world, so that
+// the nearest one of a kind can be found by only looking at the buckets around a point
+// (cells are about the size of the vision radii, so a search only touches a handful of them)
+const int spatialCellSize = 32;
+const int chunkSpatialCells = chunkSize / spatialCellSize;
+
+// Handle to a plant, rabbit or wolf. It stays valid while the entity moves around inside its
+// arrays and stops being valid once the entity is removed, even after its slot is reused.
+struct EntityHandle
+{
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
 
-    Vector2f getPosition()
+    bool operator==(const EntityHandle &other) const
     {
-        return position;
+        return slot == other.slot && generation == other.generation;
     }
 
-    // A function that choses random coordinates that are in range of
-    // the animal's sight as the next headed to value
-    void roam()
+    bool operator!=(const EntityHandle &other) const
     {
-        if (terrainGenerated)
-        {
-            Vector2f vectorToNextPoint = headedTo - position;
-            float distanceToNextPoint = pow(pow(vectorToNextPoint.x, 2) + pow(vectorToNextPoint.y, 2), 0.5);
+        return !(*this == other);
+    }
+};
 
-            // Generate new value if animal is close to the current headedTo position
-            if (distanceToNextPoint < 5)
-            {
-                // Select new point to roam to
-                int x, y;
+// An occupant of a spatial index bucket
+struct SpatialEntry
+{
+    Vector2i pixel;
+    EntityHandle handle;
+};
 
-                do
-                {
-                    float theta = (((float)(rand() % 1000) / 1000)) * (float)(2 * pi);
-                    float r = (((float)(rand() % 1000) / 1000)) * rabbitVision;
+// The WATER FIELD
+// Water never changes after a chunk is generated, so for every pixel we store the squared
+// distance to the closest water pixel and that pixel once up front. Water is looked for up to
+// waterApron past the edges of the chunk, which covers the largest vision radius.
+const int noWaterDistance = INT32_MAX;
+int waterApron = 0;
+
+// The PLANT FLOW FIELD
+// For every land pixel, the first step (towards one of its 8 neighbours) of the shortest path over land
+// to the closest plant, searched up to waterApron past the edges of the chunk. A chunk's field goes stale
+// when a plant comes or goes within reach of it, and is rebuilt at the start of the next tick, only if
+// an animal is on the chunk. Water needs no such field: the straight line to the closest water pixel
+// never crosses any other water.
+const uint8_t noFlow = 8;
+const int flowStepX[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+const int flowStepY[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+// A loaded chunk, its pixels are indexed by (y - top) * chunkSize + (x - left)
+struct Chunk
+{
+    int left = 0;
+    int top = 0;
 
-                    x = (int)round(position.x + (float)(r * cos(theta)));
-                    y = (int)round(position.y + (float)(r * sin(theta)));
+    // The POSITION BLUEPRINT
+    // One bitmask per pixel, bit n is set while something of BlueprintLayer n is on that pixel
+    uint8_t positionBlueprint[chunkSize * chunkSize];
 
-                } while (!isLand(x, y));
+    // Number of plants, rabbits and wolves on each pixel, so that a layer's bit is only
+    // cleared once the last occupant has left
+    uint16_t positionBlueprintCount[numOccupantLayers][chunkSize * chunkSize];
 
-                headedTo = Vector2f(x, y);
-            }
-        }
-    }
+    // Entries in each spatial index bucket, per occupant layer (index = layer - firstOccupantLayer)
+    vector<SpatialEntry> spatialIndex[numOccupantLayers][chunkSpatialCells * chunkSpatialCells];
 
-    // Common part of the move function for all children
-    virtual void move()
-    {
-        // Basic move funcion that just sets the animal's direction to its next goal
-        Vector2f vectorToNextPoint = headedTo - position;
-        float distanceToNextPoint = pow(pow(vectorToNextPoint.x, 2) + pow(vectorToNextPoint.y, 2), 0.5);
+    // Land pixels (inside the world) of each spatial index cell of the chunk, as pixel indices
+    // within the chunk, so that a random land pixel can be picked without any trial and error
+    vector<uint16_t> landCells[chunkSpatialCells * chunkSpatialCells];
 
-        direction = Vector2f(vectorToNextPoint.x / distanceToNextPoint, vectorToNextPoint.y / distanceToNextPoint);
-    }
+    // Water field of the chunk's pixels
+    int32_t waterDistanceSquared[chunkSize * chunkSize];
+    Vector2i nearestWater[chunkSize * chunkSize];
 
-    void update()
-    {
-        roam();
-        move();
-    }
+    // Plant flow field of the chunk's pixels (an index into flowStepX and flowStepY, or noFlow)
+    uint8_t plantFlow[chunkSize * chunkSize];
+    bool plantFlowStale = true;
+
+    // The terrain, one bit per pixel (set for land), kept apart from how it is drawn
+    uint64_t terrainBits[chunkSize * chunkSize / 64];
+
+    // The PLANT LAYER: biomass of the plant on each pixel (0 where there is none, or it has been eaten bare).
+    // Only plants with at least plantEdibleBiomass are in the blueprint and spatial index, so only they are found.
+    uint8_t plantBiomass[chunkSize * chunkSize];
+    vector<uint16_t> plantCells;     // Pixels of the chunk that grow a plant
+    uint64_t plantBits[chunkSize * chunkSize / 64]; // The same pixels, one bit each, to tell them apart in constant time
+    vector<uint16_t> regrowingCells; // Plant pixels below full biomass, the only ones regrowth looks at
+
+    // The terrain and plants as they are drawn (only made when there is a window), and the rectangle
+    // of it (in chunk pixels) that has to be painted again since a plant changed
+    Texture terrainTexture;
+    IntRect changedPixels;
+
+    // Rabbits and wolves on the chunk, a chunk is never evicted while it has any
+    int numAnimals = 0;
+
+    // Last tick anything needed the chunk
+    long long lastNeededTick = 0;
 };
 
-class Rabbit : public Animal
-{
-protected:
-    Vector2f threatsAverageLocation;
+// Every chunk of the world (index = chunkY * chunksAcross + chunkX), null while it is not loaded
+int chunksAcross = 0;
+int chunksDown = 0;
+vector<unique_ptr<Chunk>> chunks;
 
-public:
-    Rabbit(
-        float speed,
-        Vector2f direction,
-        Vector2f position,
-        float maxHunger,
-        float maxThirst,
-        float maxReproductiveUrge)
-        : Animal(
-              speed,
-              direction,
-              position,
-              maxHunger,
-              maxThirst,
-              maxReproductiveUrge),
-          threatsAverageLocation(Vector2f(-1, -1))
-    {
-        // Setting the rabbit sprite with the rabbit image and giving it size
-        Image rabbitImage;
-        rabbitImage.loadFromFile("assets/images/RabbitFace.png");
-        animalTexture.loadFromImage(rabbitImage);
-        shape.setTexture(animalTexture);
-        shape.setScale(Vector2f(shape.getScale().x / 15 * rabbitSize, shape.getScale().y / 15 * rabbitSize));
-        // shape.setFillColor(Color::White);
-        shape.setOrigin(shape.getGlobalBounds().width / 2, shape.getGlobalBounds().height / 2);
+// Indices of the chunks that are loaded, so eviction does not have to walk the whole world
+vector<int> loadedChunks;
 
-        // Setting random values for thirst hunger and mating urge
-        hungerLevel = (float)(rand() % (int)(rabbitMaxHunger));
-        thirstLevel = (float)(rand() % (int)(rabbitMaxThirst));
-        reproductiveUrge = (float)(rand() % (int)(rabbitMaxReproductiveUrge));
-    }
+// Land of a chunk's area, one bit per pixel (set for land), as the noise gives it
+struct LandMask
+{
+    uint64_t bits[chunkSize * chunkSize / 64];
+};
 
-    void move() override
-    {
-        // Calling the parent's move because it is common for both children
-        Animal::move();
+// Land mask of every chunk area the noise has been evaluated for (same index as chunks), null until then.
+// Masks outlive eviction, so the noise of an area is only ever evaluated once per world.
+vector<unique_ptr<LandMask>> landMasks;
 
-        // Calculate velocity
-        Vector2f velocity;
+// The same seed always gives the same world, however it is explored
+siv::PerlinNoise::seed_type terrainSeed = 0;
+siv::PerlinNoise terrainNoise;
 
-        velocity.x = direction.x * speed;
-        velocity.y = direction.y * speed;
+// Number of ticks simulated so far
+long long simulationTick = 0;
 
-        // Remove old position blueprint
-        removePositionFromBlueprint('r', floor(position.x), floor(position.y));
+// Boolean that is false until terrain is generated
+bool terrainGenerated = false;
 
-        position.x = position.x + velocity.x;
-        position.y = position.y + velocity.y;
+// What an animal decided to do during a tick.
+// Animals plan their tick in parallel from the same snapshot of the world and only change
+// their own fields while doing so. Everything that touches the shared world (blueprint,
+// spatial index, births and deaths) is kept here and committed afterwards in a fixed order,
+// so the outcome of a tick does not depend on how the threads were scheduled.
+// What an animal died of (kept with its intent until the death is counted)
+enum DeathCause : uint8_t
+{
+    diedOfHunger,
+    diedOfThirst,
+    diedOfPredation
+};
 
-        // Add new position to blueprint
-        addToPositionBlueprint('r', floor(position.x), floor(position.y));
+struct AnimalIntent
+{
+    Vector2i fromPixel; // Pixel the animal was on when the tick started
+    Vector2i toPixel;   // Pixel the animal moved to
+    bool givesBirth;    // A baby is born on fromPixel
+    bool eatsRabbit;    // (Wolves only) eats a rabbit standing on fromPixel
+    EntityHandle prey;  // (Wolves only) the rabbit it eats
+    bool eatsPlant;     // (Rabbits only) takes a bite of the plant on plantPixel
+    Vector2i plantPixel;
+    bool dies;          // Died of hunger or thirst, or got eaten
+    DeathCause cause;   // What it died of, if it dies
+};
 
-        shape.setPosition(position);
-    }
+// Intents of the current tick, one per animal (same order as the rabbits and wolves arrays)
+vector<AnimalIntent> rabbitIntents;
+vector<AnimalIntent> wolfIntents;
 
-    void draw(RenderWindow *window)
-    {
-        window->draw(shape);
-    }
+// Animals that died during a commit, kept between ticks so deaths do not allocate
+vector<EntityHandle> deadAnimals;
 
-    // Returns true if rabbit is near a plant
-    bool atPlant()
-    {
-        bool found = false;
-        for (int i = 0; i < 5; i++)
-        {
-            for (int j = 0; j < 5; j++)
-            {
-                found = checkPositionInBlueprint(plantCharIdentifier, position.x + i - 2, position.y + j - 2);
-                if (found)
-                    return found;
-            }
-        }
-        return found;
-    }
+// Some Function headers
+bool isLand(int x, int y);
+bool isWithinBounds(int x, int y);
+Chunk *findChunk(int x, int y);
+Chunk &needChunk(int x, int y);
+struct RandomStream;
+Vector2i randomLandPixelNear(int x, int y, RandomStream &random);
+void loadChunksIn(int left, int top, int right, int bottom);
+IntRect cameraRect();
+void addToPositionBlueprint(BlueprintLayer layer, int x, int y);
+bool checkPositionInBlueprint(BlueprintLayer layer, int x, int y);
+void removePositionFromBlueprint(BlueprintLayer layer, int x, int y);
+void addToSpatialIndex(BlueprintLayer layer, int x, int y, EntityHandle handle);
+void removeFromSpatialIndex(BlueprintLayer layer, int x, int y, EntityHandle handle);
+EntityHandle findInSpatialIndex(BlueprintLayer layer, int x, int y);
+Vector2f findNearestInSpatialIndex(BlueprintLayer layer, Vector2f position, int radius, bool skipOwnPixel);
+bool isNearWater(int x, int y, int maxDistanceSquared);
+Vector2f findNearestWater(Vector2f position, int radius);
+uint8_t plantFlowAt(Vector2f position);
+void addPlant(int x, int y, int biomass);
+bool eatPlant(Vector2i pixel);
+void repaintChangedPixels(Chunk &chunk);
+void spawnChunkPlants(Chunk &chunk, int chunkIndex);
+void removeChunkPlants(Chunk &chunk);
+void addRabbit(Vector2f position);
+void removeRabbit(EntityHandle handle);
+void addWolf(Vector2f position);
+void removeWolf(EntityHandle handle);
 
-    // Returns true if rabbit is near water
-    bool atWater()
-    {
-        bool found = false;
-        for (int i = 0; i < 5; i++)
-        {
-            for (int j = 0; j < 5; j++)
-            {
-                found = checkPositionInBlueprint(waterCharIdentifier, position.x + i - 2, position.y + j - 2);
-                if (found)
-                    return found;
-            }
-        }
-        return found;
-    }
+// ----------------- THREAD POOL ------------------
 
-    // Returns true if rabbit is near another rabbit
-    bool atMate()
+// A fixed set of worker threads that split loops between them. The thread calling
+// parallelFor works on the loop too and only returns once every index has been run.
+class ThreadPool
+{
+    vector<thread> workers;
+    mutex lock;
+    condition_variable workReady;
+    condition_variable workDone;
+
+    const function<void(int)> *job = nullptr; // Loop body of the current parallelFor
+    int jobSize = 0;                          // Number of indices in the current loop
+    int jobGrain = 1;                         // Number of indices handed out at a time
+    atomic<int> nextIndex{0};                 // First index that has not been handed out yet
+    int workersBusy = 0;                      // Workers that have not finished the current loop
+    unsigned long generation = 0;             // Incremented for every loop, so workers notice new work
+    bool stopping = false;
+
+    // Indices are handed out in small grains so that threads stay balanced
+    static const int defaultGrain = 64;
+
+    void runJob()
     {
-        bool found = false;
-        for (int i = 0; i < 3; i++)
+        for (int begin = nextIndex.fetch_add(jobGrain); begin < jobSize; begin = nextIndex.fetch_add(jobGrain))
         {
-            for (int j = 0; j < 3; j++)
+            int end = min(begin + jobGrain, jobSize);
+
+            for (int i = begin; i < end; i++)
             {
-                if (i != 0 && j != 0)
-                {
-                    found = checkPositionInBlueprint(rabbitCharIdentifier, position.x + i - 1, position.y + j - 1);
-                    if (found)
-                        return found;
-                }
+                (*job)(i);
             }
         }
-
-        return found;
     }
 
-    // A function that scans the surroundings and takes note of important things
-    void scanSurroundings()
+    void workerLoop()
     {
+        unsigned long seenGeneration = 0;
 
-        closestFoodSource = Vector2f(-1, -1);
-        closestWaterSource = Vector2f(-1, -1);
-        closestMate = Vector2f(-1, -1);
-        threatsAverageLocation = Vector2f(-1, -1);
-
-        // Scan suroundings and look for plant
-        for (int r = 0; r < rabbitVision + 1; r++)
+        while (true)
         {
-            // First checking the pixel the rabbit is currently on
-            if (r == 0)
             {
-                int search_x = round(position.x);
-                int search_y = round(position.y);
+                unique_lock<mutex> guard(lock);
+                workReady.wait(guard, [&]
+                               { return stopping || generation != seenGeneration; });
 
-                // If plant found and plant not already found (is closest)
-                if (checkPositionInBlueprint(plantCharIdentifier, search_x, search_y) && closestFoodSource == Vector2f(-1, -1))
+                if (stopping)
                 {
-                    closestFoodSource = Vector2f(search_x, search_y);
+                    return;
                 }
 
-                // If water found and is closest
-                if (checkPositionInBlueprint(waterCharIdentifier, search_x, search_y) && closestWaterSource == Vector2f(-1, -1))
-                {
-                    closestWaterSource = Vector2f(search_x, search_y);
-                }
+                seenGeneration = generation;
             }
 
-            // Checking all other pixels in the rabbit's field of vision other than its own position
-            else
-            {
-                float dtheta = (float)(1 / (float)(2 * r));
-                for (float theta = 0; theta < (2 * pi); theta += dtheta)
-                {
-                    int search_x = round(position.x + r * cos(theta));
-                    int search_y = round(position.y + r * sin(theta));
-
-                    // If plant found and plant not already found
-                    if (checkPositionInBlueprint(plantCharIdentifier, search_x, search_y) && closestFoodSource == Vector2f(-1, -1))
-                    {
-                        closestFoodSource = Vector2f(search_x, search_y);
-                    }
-
-                    // If water found
-                    if (checkPositionInBlueprint(waterCharIdentifier, search_x, search_y) && closestWaterSource == Vector2f(-1, -1))
-                    {
-                        closestWaterSource = Vector2f(search_x, search_y);
-                    }
+            runJob();
 
-                    // If mate found
-                    if (checkPositionInBlueprint(rabbitCharIdentifier, search_x, search_y) && closestMate == Vector2f(-1, -1))
-                    {
-                        if (floor(position.x) != search_x || floor(position.y) != search_y)
-                        {
+            {
+                lock_guard<mutex> guard(lock);
 
-                            closestMate = Vector2f(search_x, search_y);
-                        }
-                    }
+                if (--workersBusy == 0)
+                {
+                    workDone.notify_one();
                 }
             }
         }
     }
 
-    void update()
+public:
+    ~ThreadPool()
     {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
 
-        // Increasing hunger, thirst and reproductive urge with time
-        hungerLevel += rabbitHungerDelta;
-        thirstLevel += rabbitThirstDelta;
-        reproductiveUrge += rabbitReproductiveUrgeDelta;
-
-        // Scanning surroundings to take note of everything
-        scanSurroundings();
-
-        // Now checking where to go to next
+        workReady.notify_all();
 
-        // If hunger level is high then set next destination as food (if available)
-        if (hungerLevel > (float)(maxHunger / 2) && closestFoodSource != Vector2f(-1, -1))
+        for (int i = 0; i < workers.size(); i++)
         {
-            headedTo = closestFoodSource;
-
-            if (atPlant())
-            {
-                hungerLevel = 0;
-            }
+            workers[i].join();
         }
-        // Else if thirst level is high then set next destination as water (if available)
-        else if (thirstLevel > (float)(maxThirst / 2) && closestWaterSource != Vector2f(-1, -1))
-        {
-            headedTo = closestWaterSource;
+    }
 
-            if (atWater())
-            {
-                thirstLevel = 0;
-            }
-        }
-        // Else if reprodcutive urge is high then set next destination as mate (if available)
-        else if (reproductiveUrge > (float)(maxReproductiveUrge / 2) && closestMate != Vector2f(-1, -1))
+    // Starts the workers, the calling thread counts as one of the threads
+    void start(int threads)
+    {
+        for (int i = 1; i < threads; i++)
         {
-            headedTo = closestMate;
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
 
-            if (atMate())
+    // Runs body(i) for every i in [0, n) across all threads, handing out grain indices at a time
+    // (a smaller grain for loops with few but expensive iterations)
+    void parallelFor(int n, const function<void(int)> &body, int grain = defaultGrain)
+    {
+        // Not worth waking anyone up for a single grain
+        if (workers.empty() || n <= grain)
+        {
+            for (int i = 0; i < n; i++)
             {
-                reproductiveUrge = 0;
-                // CREATE BABY
-                addRabbit(position);
+                body(i);
             }
-        }
-        // If all urges satisfied, then just roam randomly
-        else
-        {
-            roam();
+
+            return;
         }
 
-        // Kill if too much hunger or thirst
-        if (hungerLevel > maxHunger || thirstLevel > maxThirst)
         {
-            removeRabbit(position);
+            lock_guard<mutex> guard(lock);
+            job = &body;
+            jobSize = n;
+            jobGrain = grain;
+            nextIndex = 0;
+            workersBusy = workers.size();
+            generation++;
         }
 
-        // Move towards the next point (headed to)
-        move();
-    }
-};
-
-// Same as above except food is rabbit instead of plant and mate is fox instead of rabbit
-class Wolf : public Animal
-{
-protected:
-public:
-    Wolf(
-        float speed,
-        Vector2f direction,
-        Vector2f position,
-        float maxHunger,
-        float maxThirst,
-        float maxReproductiveUrge)
-        : Animal(
-              speed,
-              direction,
-              position,
-              maxHunger,
-              maxThirst,
-              maxReproductiveUrge)
-    {
-
-        Image wolfImage;
-        wolfImage.loadFromFile("assets/images/WolfFace.png");
-        animalTexture.loadFromImage(wolfImage);
-        shape.setTexture(animalTexture);
-        shape.setScale(Vector2f(shape.getScale().x / 12 * wolfSize, shape.getScale().y / 12 * wolfSize));
+        workReady.notify_all();
 
-        shape.setOrigin(shape.getScale().x / 2, shape.getScale().y / 2);
+        runJob();
 
-        // Setting random values for thirst hunger and mating urge
-        hungerLevel = (float)(rand() % (int)(wolfMaxHunger));
-        thirstLevel = (float)(rand() % (int)(wolfMaxThirst));
-        reproductiveUrge = (float)(rand() % (int)(wolfMaxReproductiveUrge));
+        unique_lock<mutex> guard(lock);
+        workDone.wait(guard, [&]
+                      { return workersBusy == 0; });
+        job = nullptr;
     }
+};
 
-    void move() override
-    {
+ThreadPool threadPool;
 
-        Animal::move();
+// ----------------- RANDOM NUMBERS ------------------
 
-        Vector2f velocity;
+// Random numbers are counter based: a number is a hash of the world seed, who asks for it (an
+// entity ID or one of the streams below), the tick and how many numbers were drawn before it.
+// There is no shared generator state, so threads never wait on each other for random numbers
+// and the same world seed always gives the same run.
 
-        velocity.x = direction.x * speed;
-        velocity.y = direction.y * speed;
+// Streams that do not belong to an entity (entity IDs count up from 1, so they never get this far)
+const uint64_t terrainStream = 1ull << 62;
+const uint64_t spawnRabbitStream = terrainStream + 1;
+const uint64_t spawnWolfStream = terrainStream + 2;
+const uint64_t chunkPlantStream = 1ull << 63; // Plus the chunk's index
 
-        // Remove old position blueprint
-        removePositionFromBlueprint(wolfCharIdentifier, floor(position.x), floor(position.y));
+// Ticks never get this far, so the numbers an animal's traits are drawn from are its own
+const uint64_t traitsTick = UINT64_MAX;
 
-        position.x = position.x + velocity.x;
-        position.y = position.y + velocity.y;
+// ID of the next rabbit or wolf to be added
+uint64_t nextEntityId = 1;
 
-        addToPositionBlueprint(wolfCharIdentifier, floor(position.x), floor(position.y));
+// SplitMix64 finalizer, a cheap hash that spreads every input bit over the whole output
+uint64_t splitMix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
 
-        shape.setPosition(position);
-    }
+// The random numbers of one stream during one tick
+struct RandomStream
+{
+    uint64_t key;
+    uint64_t counter = 0;
 
-    void draw(RenderWindow *window)
+    RandomStream(uint64_t stream, uint64_t tick) : key(splitMix64(splitMix64(worldSeed ^ splitMix64(stream)) ^ tick))
     {
-        window->draw(shape);
     }
 
-    bool atRabbit()
+    uint64_t next()
     {
-
-        return checkPositionInBlueprint(rabbitCharIdentifier, position.x, position.y);
+        return splitMix64(key + counter++);
     }
 
-    bool atWater()
+    // Random number in [0, n)
+    int below(int n)
     {
-        bool found = false;
-        for (int i = 0; i < 5; i++)
-        {
-            for (int j = 0; j < 5; j++)
-            {
-                found = checkPositionInBlueprint(waterCharIdentifier, position.x + i - 2, position.y + j - 2);
-                if (found)
-                    return found;
-            }
-        }
-        return found;
+        return (int)(next() % (uint64_t)n);
     }
+};
 
-    bool atMate()
-    {
-        bool found = false;
-        for (int i = 0; i < 3; i++)
-        {
-            for (int j = 0; j < 3; j++)
-            {
-                if (i != 0 && j != 0)
-                {
-                    found = checkPositionInBlueprint(wolfCharIdentifier, position.x + i - 1, position.y + j - 1);
-                    if (found)
-                        return found;
-                }
-            }
-        }
-
-        return found;
-    }
+// ----------------- PROFILER ------------------
 
-    void scanSurroundings()
-    {
+// Parts of a frame that are timed while profiling. Scan, move and remove add up every call
+// during the frame (scans from every thread), the rest are timed once per tick or draw.
+enum ProfilePhase
+{
+    profileLoadChunks,
+    profilePlantFlow,
+    profilePlanRabbits,
+    profilePlanWolves,
+    profileScan,
+    profileCommitWolves,
+    profileCommitRabbits,
+    profileMove,
+    profileRemove,
+    profileRegrowPlants,
+    profileEvictChunks,
+    profileDraw,
+    profileDrawTerrain,
+    profileDrawRabbits,
+    profileDrawWolves,
+    profileDrawStats,
+    numProfilePhases
+};
 
-        closestFoodSource = Vector2f(-1, -1);
-        closestWaterSource = Vector2f(-1, -1);
-        closestMate = Vector2f(-1, -1);
+const char *profilePhaseNames[numProfilePhases] = {
+    "load_chunks", "plant_flow", "plan_rabbits", "plan_wolves", "scan", "commit_wolves", "commit_rabbits", "move", "remove",
+    "regrow_plants", "evict_chunks", "draw", "draw_terrain", "draw_rabbits", "draw_wolves", "draw_stats"};
 
-        // Scan suroundings and look for plant
-        for (int r = 0; r < wolfVision + 1; r++)
-        {
-            // First checking the pixel the wolf is currently on
-            if (r == 0)
-            {
-                int search_x = round(position.x);
-                int search_y = round(position.y);
+// Only on while the overlay is shown (F3) or a CSV is written (--profile FILE), timers are a single check otherwise
+bool profiling = false;
+bool showProfile = false;
+FILE *profileFile = nullptr;
 
-                // If rabbit found and plant not already found
-                if (checkPositionInBlueprint(rabbitCharIdentifier, search_x, search_y) && closestFoodSource == Vector2f(-1, -1))
-                {
-                    closestFoodSource = Vector2f(search_x, search_y);
-                }
+// Number of past frames the percentiles are taken over
+const int profileWindow = 240;
 
-                // If water found
-                if (checkPositionInBlueprint(waterCharIdentifier, search_x, search_y) && closestWaterSource == Vector2f(-1, -1))
-                {
-                    closestWaterSource = Vector2f(search_x, search_y);
-                }
-            }
-            // Checking all other pixels in the wolf's field of vision other than its own position
-            else
-            {
-                float dtheta = (float)(1 / (float)(2 * r));
-                for (float theta = 0; theta < (2 * pi); theta += dtheta)
-                {
-                    int search_x = round(position.x + r * cos(theta));
-                    int search_y = round(position.y + r * sin(theta));
+// Microseconds spent in each phase during the current frame (a frame is one tick when headless)
+atomic<int64_t> profileFrameTime[numProfilePhases];
 
-                    // If rabbit found and plant not already found
-                    if (checkPositionInBlueprint(rabbitCharIdentifier, search_x, search_y) && closestFoodSource == Vector2f(-1, -1))
-                    {
-                        closestFoodSource = Vector2f(search_x, search_y);
-                    }
+// Microseconds spent in each phase during the last profileWindow frames, as a ring
+int64_t profileHistory[numProfilePhases][profileWindow];
+long long profileFrames = 0;
 
-                    // If water found
-                    if (checkPositionInBlueprint(waterCharIdentifier, search_x, search_y) && closestWaterSource == Vector2f(-1, -1))
-                    {
-                        closestWaterSource = Vector2f(search_x, search_y);
-                    }
+int64_t profileNow()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-                    // If mate found
-                    if (checkPositionInBlueprint(wolfCharIdentifier, search_x, search_y) && closestMate == Vector2f(-1, -1))
-                    {
-                        if (floor(position.x) != search_x || floor(position.y) != search_y)
-                        {
+// Adds the time from its creation to its destruction (or stop) to a phase of the current frame
+class ProfileScope
+{
+    ProfilePhase phase;
+    int64_t start;
 
-                            closestMate = Vector2f(search_x, search_y);
-                        }
-                    }
-                }
-            }
-        }
+public:
+    explicit ProfileScope(ProfilePhase timedPhase) : phase(timedPhase), start(profiling ? profileNow() : -1)
+    {
     }
 
-    void update()
+    ~ProfileScope()
     {
+        stop();
+    }
 
-        hungerLevel += wolfHungerDelta;
-        thirstLevel += wolfThirstDelta;
-        reproductiveUrge += wolfReproductiveUrgeDelta;
-
-        scanSurroundings();
-
-        // If hunger level is down then check for plant before roaming
-        if (hungerLevel > (float)(maxHunger / 2) && closestFoodSource != Vector2f(-1, -1))
-        {
-            headedTo = closestFoodSource;
-
-            if (atRabbit())
-            {
-                hungerLevel = 0;
-
-                removeRabbit(Vector2f(floor(position.x), floor(position.y)));
-            }
-        }
-        else if (thirstLevel > (float)(maxThirst / 2) && closestWaterSource != Vector2f(-1, -1))
-        {
-            headedTo = closestWaterSource;
-
-            if (atWater())
-            {
-                thirstLevel = 0;
-            }
-        }
-        else if (reproductiveUrge > (float)(maxReproductiveUrge / 2) && closestMate != Vector2f(-1, -1))
-        {
-            headedTo = closestMate;
-
-            if (atMate())
-            {
-                reproductiveUrge = 0;
-                // CREATE BABY
-                addWolf(position);
-            }
-        }
-        else
-        {
-            roam();
-        }
-
-        // Kill if too much hunger
-        if (hungerLevel > maxHunger || thirstLevel > maxThirst)
+    void stop()
+    {
+        if (start >= 0)
         {
-            removeWolf(position);
+            profileFrameTime[phase].fetch_add(profileNow() - start, memory_order_relaxed);
+            start = -1;
         }
-
-        move();
     }
 };
 
-class Plant
+// Turns profiling on or off depending on whether anything uses the results
+void updateProfiling()
 {
-    CircleShape shape;
-    Vector2f position;
-
-public:
-    Plant(Vector2f position) : position(position)
-    {
-        // Set graphical stuff
-        shape.setRadius(plantSize);
-        shape.setOutlineColor(Color(0, 50, 0, 255));
-        shape.setOutlineThickness(0.5);
-        // Centering the shape's origin
-        shape.setOrigin(shape.getGlobalBounds().width / 2, shape.getGlobalBounds().height / 2);
-        shape.setPosition(floor(position.x), floor(position.y));
+    profiling = showProfile || profileFile;
+}
 
-        shape.setFillColor(Color(treeColorRGBA[0], treeColorRGBA[1], treeColorRGBA[2], treeColorRGBA[3]));
-    }
+// Opens the CSV every frame's phase times are written to, returns false if it could not be opened
+bool openProfileFile(const string &path)
+{
+    profileFile = fopen(path.c_str(), "w");
 
-    Vector2f getPosition()
+    if (!profileFile)
     {
-        return this->position;
+        return false;
     }
 
-    void draw(RenderWindow *window)
+    fprintf(profileFile, "frame");
+    for (int phase = 0; phase < numProfilePhases; phase++)
     {
-        window->draw(shape);
+        fprintf(profileFile, ",%s_us", profilePhaseNames[phase]);
     }
-};
+    fprintf(profileFile, "\n");
 
-void displayLoadingScreen(RenderWindow *window)
+    updateProfiling();
+    return true;
+}
+
+// Files the current frame's phase times into the history (and the CSV) and starts the next frame
+void endProfileFrame()
 {
+    if (!profiling)
+    {
+        return;
+    }
 
-    // Creating and setting text
-    Text headingText;
-    Font font;
-    font.loadFromFile("assets/fonts/8-bit-hud.ttf");
-    headingText.setFont(font);
-    headingText.setString("Generating\nTerrain...");
+    int slot = profileFrames % profileWindow;
 
-    headingText.setCharacterSize(25);
+    if (profileFile)
+    {
+        fprintf(profileFile, "%lld", profileFrames);
+    }
 
-    sf::FloatRect bounds = headingText.getLocalBounds();
-    headingText.setOrigin(-bounds.left + bounds.width / 2.f, -bounds.top + bounds.height / 2.f);
+    for (int phase = 0; phase < numProfilePhases; phase++)
+    {
+        profileHistory[phase][slot] = profileFrameTime[phase].exchange(0, memory_order_relaxed);
 
-    headingText.setPosition(Vector2f(window->getSize().x / 2, window->getSize().y / 2));
-    headingText.setFillColor(Color::White);
+        if (profileFile)
+        {
+            fprintf(profileFile, ",%lld", (long long)profileHistory[phase][slot]);
+        }
+    }
 
-    // Drawing and displaying loading screen text
-    window->clear();
-    window->draw(headingText);
+    if (profileFile)
+    {
+        fprintf(profileFile, "\n");
+    }
 
-    window->display();
+    profileFrames++;
 }
 
-void drawPopulationStats(RenderWindow *window)
+// Microseconds a phase took in the given percentile (0 to 100) of the frames in the history
+int64_t profilePercentile(ProfilePhase phase, int percentile)
 {
-    // Drawing a translucent rectangle and the number of population
-    // as text on top of it.
-
-    Text text;
-    Font font;
-    font.loadFromFile("assets/fonts/Jersey15-Regular.ttf");
-    text.setFont(font);
+    int count = min<long long>(profileFrames, profileWindow);
 
-    String textString = "Rabbits Alive: " + to_string(rabbits.size()) + "                                                                                                                                                                     Wolves Alive: " + to_string(wolves.size());
-    RectangleShape shape(Vector2f(width, 30));
-
-    shape.setFillColor(Color(0, 0, 0, 255 * 0.9));
-    text.setFillColor(Color::White);
+    if (count == 0)
+    {
+        return 0;
+    }
 
-    text.setString(textString);
-    text.setCharacterSize(20);
+    int64_t times[profileWindow];
+    copy(profileHistory[phase], profileHistory[phase] + count, times);
 
-    shape.setPosition(Vector2f(0, 0));
-    text.setPosition(Vector2f((width / 2) - (text.getLocalBounds().width / 2), (text.getLocalBounds().height - 10)));
+    int rank = min(count - 1, count * percentile / 100);
+    nth_element(times, times + rank, times + count);
 
-    window->draw(shape);
-    window->draw(text);
+    return times[rank];
 }
 
-bool onIntro = true;
+// ----------------- METRICS RECORDER ------------------
 
-void drawIntroScreen(RenderWindow *window)
+// What happened to one species during a tick
+struct SpeciesMetrics
 {
-    // Draw the intro menu image
-    Image introImage;
-    introImage.loadFromFile("assets/images/IntroScreen.png");
-    Texture introTexture;
-    introTexture.loadFromImage(introImage);
-
-    Sprite introSprite;
-    introSprite.setTexture(introTexture);
-    introSprite.setScale(0.5, 0.5);
+    uint32_t population;
+    uint32_t births;
+    uint32_t hungerDeaths;
+    uint32_t thirstDeaths;
+    uint32_t predationDeaths;
+    float meanHunger;
+    float meanThirst;
+    float meanSpeed;
+};
+
+enum MetricsSpecies
+{
+    rabbitMetrics,
+    wolfMetrics,
+    numMetricsSpecies
+};
+
+const char *metricsSpeciesNames[numMetricsSpecies] = {"rabbit", "wolf"};
+
+struct TickMetrics
+{
+    int64_t tick;
+    SpeciesMetrics species[numMetricsSpecies];
+};
+
+// Births and deaths of the current tick, counted as the plans are committed
+TickMetrics tickMetrics = {};
+
+// The columns of the metrics file after the tick, once for every species in this order
+struct
+{
+    const char *name;
+    uint32_t SpeciesMetrics::*field;
+} metricsCountColumns[] = {
+    {"population", &SpeciesMetrics::population},
+    {"births", &SpeciesMetrics::births},
+    {"hunger_deaths", &SpeciesMetrics::hungerDeaths},
+    {"thirst_deaths", &SpeciesMetrics::thirstDeaths},
+    {"predation_deaths", &SpeciesMetrics::predationDeaths}};
+
+struct
+{
+    const char *name;
+    float SpeciesMetrics::*field;
+} metricsMeanColumns[] = {
+    {"mean_hunger", &SpeciesMetrics::meanHunger},
+    {"mean_thirst", &SpeciesMetrics::meanThirst},
+    {"mean_speed", &SpeciesMetrics::meanSpeed}};
+
+// Keeps the metrics of every tick in a ring that a background thread writes out, so the simulation never
+// waits on the disk. Either as CSV (for a file ending in .csv) or in a compact columnar format:
+//   magic, version, column count, then for every column its type ('q' int64, 'I' uint32, 'f' float32),
+//   name length and name
+//   blocks until the end of the file: row count, then each column's values for those rows (little endian)
+// If the writer ever falls a whole ring behind, ticks are dropped rather than waited for (and counted).
+class MetricsRecorder
+{
+    static const int ringSize = 4096;
+
+    // The writer is woken up once this many ticks are waiting (and every so often anyway)
+    static const int flushEvery = 256;
+
+    TickMetrics ring[ringSize];
+    atomic<long long> recorded{0}; // Ticks put in the ring (only the simulation moves this)
+    atomic<long long> written{0};  // Ticks taken out of the ring (only the writer moves this)
+    long long dropped = 0;
+
+    FILE *file = nullptr;
+    bool csv = false;
+    thread writer;
+    mutex lock;
+    condition_variable ticksWaiting;
+    atomic<bool> stopping{false};
+
+    void writeHeader()
+    {
+        if (csv)
+        {
+            fprintf(file, "tick");
+            for (int s = 0; s < numMetricsSpecies; s++)
+            {
+                for (auto &column : metricsCountColumns)
+                {
+                    fprintf(file, ",%s_%s", metricsSpeciesNames[s], column.name);
+                }
+                for (auto &column : metricsMeanColumns)
+                {
+                    fprintf(file, ",%s_%s", metricsSpeciesNames[s], column.name);
+                }
+            }
+            fprintf(file, "\n");
+            return;
+        }
+
+        const char magic[8] = {'C', 'O', 'E', 'X', 'M', 'E', 'T', 'R'};
+        uint32_t version = 1;
+        uint32_t numColumns = 1 + numMetricsSpecies * (size(metricsCountColumns) + size(metricsMeanColumns));
+
+        fwrite(magic, 1, sizeof(magic), file);
+        fwrite(&version, sizeof(version), 1, file);
+        fwrite(&numColumns, sizeof(numColumns), 1, file);
+
+        auto writeColumn = [&](char type, const string &name)
+        {
+            uint8_t length = name.size();
+            fputc(type, file);
+            fputc(length, file);
+            fwrite(name.data(), 1, length, file);
+        };
+
+        writeColumn('q', "tick");
+        for (int s = 0; s < numMetricsSpecies; s++)
+        {
+            for (auto &column : metricsCountColumns)
+            {
+                writeColumn('I', string(metricsSpeciesNames[s]) + "_" + column.name);
+            }
+            for (auto &column : metricsMeanColumns)
+            {
+                writeColumn('f', string(metricsSpeciesNames[s]) + "_" + column.name);
+            }
+        }
+    }
+
+    void writeRows(const vector<TickMetrics> &rows)
+    {
+        if (csv)
+        {
+            for (const TickMetrics &row : rows)
+            {
+                fprintf(file, "%lld", (long long)row.tick);
+                for (int s = 0; s < numMetricsSpecies; s++)
+                {
+                    for (auto &column : metricsCountColumns)
+                    {
+                        fprintf(file, ",%u", row.species[s].*column.field);
+                    }
+                    for (auto &column : metricsMeanColumns)
+                    {
+                        fprintf(file, ",%.3f", row.species[s].*column.field);
+                    }
+                }
+                fprintf(file, "\n");
+            }
+            return;
+        }
+
+        // One block, a column at a time
+        vector<char> block;
+        auto append = [&](const void *value, size_t bytes)
+        {
+            block.insert(block.end(), (const char *)value, (const char *)value + bytes);
+        };
+
+        uint32_t count = rows.size();
+        append(&count, sizeof(count));
+
+        for (const TickMetrics &row : rows)
+        {
+            append(&row.tick, sizeof(row.tick));
+        }
+
+        for (int s = 0; s < numMetricsSpecies; s++)
+        {
+            for (auto &column : metricsCountColumns)
+            {
+                for (const TickMetrics &row : rows)
+                {
+                    append(&(row.species[s].*column.field), sizeof(uint32_t));
+                }
+            }
+            for (auto &column : metricsMeanColumns)
+            {
+                for (const TickMetrics &row : rows)
+                {
+                    append(&(row.species[s].*column.field), sizeof(float));
+                }
+            }
+        }
+
+        fwrite(block.data(), 1, block.size(), file);
+    }
+
+    void writerLoop()
+    {
+        vector<TickMetrics> rows;
+
+        while (true)
+        {
+            {
+                unique_lock<mutex> guard(lock);
+                ticksWaiting.wait_for(guard, chrono::milliseconds(100), [&]
+                                      { return stopping || recorded - written >= flushEvery; });
+            }
+
+            // Taking what is in the ring now, the simulation keeps filling the rest meanwhile
+            long long first = written.load();
+            long long last = recorded.load(memory_order_acquire);
+
+            rows.clear();
+            for (long long t = first; t < last; t++)
+            {
+                rows.push_back(ring[t % ringSize]);
+            }
+
+            written.store(last, memory_order_release);
+
+            if (!rows.empty())
+            {
+                writeRows(rows);
+            }
+
+            if (stopping && recorded.load(memory_order_acquire) == last)
+            {
+                return;
+            }
+        }
+    }
+
+public:
+    ~MetricsRecorder()
+    {
+        close();
+    }
+
+    bool recording() const
+    {
+        return file;
+    }
+
+    // Starts writing every recorded tick to the file, returns false if it could not be opened
+    bool open(const string &path)
+    {
+        file = fopen(path.c_str(), "wb");
+
+        if (!file)
+        {
+            return false;
+        }
+
+        csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+        writeHeader();
+
+        writer = thread(&MetricsRecorder::writerLoop, this);
+        return true;
+    }
+
+    // Puts a tick's metrics in the ring (called from the simulation thread only)
+    void record(const TickMetrics &metrics)
+    {
+        if (!file)
+        {
+            return;
+        }
+
+        long long t = recorded.load(memory_order_relaxed);
+
+        if (t - written.load(memory_order_acquire) >= ringSize)
+        {
+            dropped++;
+            return;
+        }
+
+        ring[t % ringSize] = metrics;
+        recorded.store(t + 1, memory_order_release);
+
+        if ((t + 1) % flushEvery == 0)
+        {
+            ticksWaiting.notify_one();
+        }
+    }
+
+    // Writes out whatever is left in the ring and closes the file
+    void close()
+    {
+        if (!file)
+        {
+            return;
+        }
+
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+
+        ticksWaiting.notify_one();
+        writer.join();
+
+        fclose(file);
+        file = nullptr;
+
+        if (dropped > 0)
+        {
+            fprintf(stderr, "Metrics of %lld ticks were dropped, the file could not be written fast enough\n", dropped);
+        }
+    }
+};
+
+MetricsRecorder metricsRecorder;
+
+// ----------------- CLASSES ------------------
+
+// Cuts a vector's memory down to the given capacity (at least its size). Vectors never give memory
+// back on their own, so without this they stay as big as they have ever been.
+template <class T>
+void shrinkCapacity(vector<T> &values, size_t capacity)
+{
+    vector<T> smaller;
+    smaller.reserve(max(capacity, values.size()));
+    smaller.assign(values.begin(), values.end());
+    values.swap(smaller);
+}
+
+// Hands out handles for entities kept in dense arrays, and keeps track of the array index
+// each handle points to. Entities are removed by moving the last one into the hole
+// (swap and pop), so both adding and removing take constant time.
+class HandleTable
+{
+    vector<uint32_t> indexOfSlot;      // Array index of the entity using each slot
+    vector<uint32_t> generationOfSlot; // Bumped every time a slot's entity is removed
+    vector<uint32_t> freeSlots;        // Slots waiting to be reused
+    vector<EntityHandle> handleAt;     // Handle of the entity at each array index
+
+public:
+    int size() const
+    {
+        return handleAt.size();
+    }
+
+    // Creates the handle for an entity added at the end of the arrays
+    EntityHandle add()
+    {
+        EntityHandle handle;
+
+        if (freeSlots.empty())
+        {
+            handle.slot = indexOfSlot.size();
+            indexOfSlot.push_back(0);
+            generationOfSlot.push_back(0);
+        }
+        else
+        {
+            handle.slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+
+        handle.generation = generationOfSlot[handle.slot];
+        indexOfSlot[handle.slot] = handleAt.size();
+        handleAt.push_back(handle);
+
+        return handle;
+    }
+
+    // Returns the array index of the entity, or -1 if it has been removed
+    int indexOf(EntityHandle handle) const
+    {
+        if (handle.slot >= generationOfSlot.size() || generationOfSlot[handle.slot] != handle.generation)
+        {
+            return -1;
+        }
+
+        return indexOfSlot[handle.slot];
+    }
+
+    EntityHandle at(int index) const
+    {
+        return handleAt[index];
+    }
+
+    // Cuts the handle array down to the given capacity. Slots are kept, since old handles
+    // point into them, and are reused for new entities anyway.
+    void shrinkTo(int capacity)
+    {
+        shrinkCapacity(handleAt, capacity);
+    }
+
+    // Forgets the entity at the index. The caller has to move the last entity of its
+    // arrays into that index (unless it was the last one) and pop the back.
+    void removeAt(int index)
+    {
+        EntityHandle removed = handleAt[index];
+
+        generationOfSlot[removed.slot]++;
+        freeSlots.push_back(removed.slot);
+
+        handleAt[index] = handleAt.back();
+        indexOfSlot[handleAt[index].slot] = index;
+        handleAt.pop_back();
+    }
+};
+
+// Every animal array has room for at least this many animals from the start, so the first births never reallocate
+const int minAnimalCapacity = 1024;
+
+// Storage for every animal of one species, as a structure of arrays: each field of an
+// animal lives in its own contiguous array, and index i of every array is the same animal.
+// Loops over the animals only pull in the fields they actually use.
+struct AnimalStore
+{
+    HandleTable handles;             // Handle of every animal
+    vector<Vector2f> position;       // Current position of the animal
+    vector<Vector2f> lastPosition;   // Position before the last tick (only kept up when drawing)
+    vector<Vector2f> headedTo;       // Where the animal is currently headed
+    vector<float> speed;             // Speed of the animal
+    vector<float> hungerLevel;       // Current hunger level of the animal
+    vector<float> thirstLevel;       // Current thirst level of the animal
+    vector<float> reproductiveUrge;  // Current reproductive urge of the animal
+    vector<uint64_t> id;             // ID of the animal, its random numbers are keyed by it
+    vector<int> bucketSlot;          // Where the animal's entry is in its spatial index bucket (kept by the index)
+
+    AnimalStore()
+    {
+        reserve(minAnimalCapacity);
+    }
+
+    int size() const
+    {
+        return handles.size();
+    }
+
+    int capacity() const
+    {
+        return position.capacity();
+    }
+
+    // Adds an animal at the end of the arrays and returns its handle
+    EntityHandle add(Vector2f animalPosition, float animalSpeed, float hunger, float thirst, float urge, uint64_t animalId)
+    {
+        position.push_back(animalPosition);
+        lastPosition.push_back(animalPosition);
+        // Setting the initial headed to to a valid value so that it doesnt break
+        headedTo.push_back(animalPosition);
+        speed.push_back(animalSpeed);
+        hungerLevel.push_back(hunger);
+        thirstLevel.push_back(thirst);
+        reproductiveUrge.push_back(urge);
+        id.push_back(animalId);
+        bucketSlot.push_back(-1);
+
+        return handles.add();
+    }
+
+    // Copies every field of the animal at index from over the animal at index to
+    void moveEntry(int from, int to)
+    {
+        position[to] = position[from];
+        lastPosition[to] = lastPosition[from];
+        headedTo[to] = headedTo[from];
+        speed[to] = speed[from];
+        hungerLevel[to] = hungerLevel[from];
+        thirstLevel[to] = thirstLevel[from];
+        reproductiveUrge[to] = reproductiveUrge[from];
+        id[to] = id[from];
+        bucketSlot[to] = bucketSlot[from];
+    }
+
+    // Makes room for n animals in every array
+    void reserve(int n)
+    {
+        position.reserve(n);
+        lastPosition.reserve(n);
+        headedTo.reserve(n);
+        speed.reserve(n);
+        hungerLevel.reserve(n);
+        thirstLevel.reserve(n);
+        reproductiveUrge.reserve(n);
+        id.reserve(n);
+        bucketSlot.reserve(n);
+    }
+
+    // Gives memory back after the population has crashed: once the arrays are less than a quarter
+    // full they are cut down to twice the population, so memory follows the live population while
+    // births and deaths around the current size still never reallocate
+    void trim()
+    {
+        if (capacity() <= minAnimalCapacity || size() * 4 > capacity())
+        {
+            return;
+        }
+
+        int kept = max(minAnimalCapacity, size() * 2);
+
+        handles.shrinkTo(kept);
+        shrinkCapacity(position, kept);
+        shrinkCapacity(lastPosition, kept);
+        shrinkCapacity(headedTo, kept);
+        shrinkCapacity(speed, kept);
+        shrinkCapacity(hungerLevel, kept);
+        shrinkCapacity(thirstLevel, kept);
+        shrinkCapacity(reproductiveUrge, kept);
+        shrinkCapacity(id, kept);
+        shrinkCapacity(bucketSlot, kept);
+    }
+
+    // Keeps the first n animals
+    void resize(int n)
+    {
+        position.resize(n);
+        lastPosition.resize(n);
+        headedTo.resize(n);
+        speed.resize(n);
+        hungerLevel.resize(n);
+        thirstLevel.resize(n);
+        reproductiveUrge.resize(n);
+        id.resize(n);
+        bucketSlot.resize(n);
+    }
+
+    // Removes the animal at the index by moving the last animal into its place
+    void removeAt(int index)
+    {
+        int last = size() - 1;
+
+        handles.removeAt(index);
+
+        if (index != last)
+        {
+            moveEntry(last, index);
+        }
+
+        resize(last);
+    }
+};
+
+// Stores for all rabbits and wolves
+AnimalStore rabbits;
+AnimalStore wolves;
+
+// Rabbits or wolves (by their blueprint layer)
+AnimalStore &animalsOfLayer(BlueprintLayer layer)
+{
+    return layer == rabbitLayer ? rabbits : wolves;
+}
+
+// ------------ ANIMAL FUNCTIONS ----------------
+// (Shared by rabbits and wolves)
+
+// Counts a death under its cause
+void countDeath(SpeciesMetrics &metrics, DeathCause cause)
+{
+    if (cause == diedOfHunger)
+    {
+        metrics.hungerDeaths++;
+    }
+    else if (cause == diedOfThirst)
+    {
+        metrics.thirstDeaths++;
+    }
+    else
+    {
+        metrics.predationDeaths++;
+    }
+}
+
+// Marks the animal's intent as dying of the cause where it stands, returns the intent
+AnimalIntent &dieInPlace(AnimalIntent &intent, DeathCause cause)
+{
+    intent.dies = true;
+    intent.cause = cause;
+    intent.toPixel = intent.fromPixel;
+    return intent;
+}
+
+// Fills in the population and the mean hunger, thirst and speed of a species
+void measureSpecies(SpeciesMetrics &metrics, const AnimalStore &animals)
+{
+    int count = animals.size();
+    double hunger = 0, thirst = 0, speed = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        hunger += animals.hungerLevel[i];
+        thirst += animals.thirstLevel[i];
+        speed += animals.speed[i];
+    }
+
+    metrics.population = count;
+    metrics.meanHunger = count > 0 ? hunger / count : 0;
+    metrics.meanThirst = count > 0 ? thirst / count : 0;
+    metrics.meanSpeed = count > 0 ? speed / count : 0;
+}
+
+// A function that choses random coordinates that are in range of
+// the animal's sight as the next headed to value
+void roam(AnimalStore &animals, int i)
+{
+    if (terrainGenerated)
+    {
+        Vector2f vectorToNextPoint = animals.headedTo[i] - animals.position[i];
+        float distanceToNextPoint = pow(pow(vectorToNextPoint.x, 2) + pow(vectorToNextPoint.y, 2), 0.5);
+
+        // Generate new value if animal is close to the current headedTo position
+        if (distanceToNextPoint < 5)
+        {
+            // Select new point to roam to
+            int x, y;
+            bool onLand = false;
+            RandomStream random(animals.id[i], simulationTick);
+
+            for (int attempt = 0; attempt < roamAttempts && !onLand; attempt++)
+            {
+                float theta = (((float)(random.below(1000)) / 1000)) * (float)(2 * pi);
+                float r = (((float)(random.below(1000)) / 1000)) * rabbitVision;
+
+                x = (int)round(animals.position[i].x + (float)(r * cos(theta)));
+                y = (int)round(animals.position[i].y + (float)(r * sin(theta)));
+
+                onLand = isLand(x, y);
+            }
+
+            // Hardly any land around (a small island, or out in the water), so picking straight
+            // from the land of the animal's region, or staying put if there is none
+            if (!onLand)
+            {
+                Vector2i land = randomLandPixelNear(floor(animals.position[i].x), floor(animals.position[i].y), random);
+
+                x = land.x < 0 ? floor(animals.position[i].x) : land.x;
+                y = land.x < 0 ? floor(animals.position[i].y) : land.y;
+            }
+
+            animals.headedTo[i] = Vector2f(x, y);
+        }
+    }
+}
+
+// Moves the animal one step towards its next goal (headed to), or along the given flow field step
+// when there is one. Only the animal itself is changed, its blueprint and spatial index entries
+// are moved when the tick is committed.
+void moveAnimal(AnimalStore &animals, int i, uint8_t flow = noFlow)
+{
+    // Setting the animal's direction to its next goal
+    Vector2f vectorToNextPoint = animals.headedTo[i] - animals.position[i];
+
+    if (flow != noFlow)
+    {
+        vectorToNextPoint = Vector2f(flowStepX[flow], flowStepY[flow]);
+    }
+    float distanceToNextPoint = pow(pow(vectorToNextPoint.x, 2) + pow(vectorToNextPoint.y, 2), 0.5);
+
+    // Standing still when already there, instead of dividing by zero
+    if (distanceToNextPoint > 0)
+    {
+        Vector2f direction(vectorToNextPoint.x / distanceToNextPoint, vectorToNextPoint.y / distanceToNextPoint);
+
+        animals.position[i].x = animals.position[i].x + direction.x * animals.speed[i];
+        animals.position[i].y = animals.position[i].y + direction.y * animals.speed[i];
+    }
+}
+
+// Returns true if there is water near the position
+bool atWater(Vector2f position)
+{
+    // Every pixel of the 5x5 window around the animal is at most 8 away (squared), and nothing outside it is
+    return isNearWater(floor(position.x), floor(position.y), 8);
+}
+
+// Returns true if another animal of the layer is next to the position
+bool atMate(BlueprintLayer layer, Vector2f position)
+{
+    bool found = false;
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            if (i != 0 && j != 0)
+            {
+                found = checkPositionInBlueprint(layer, position.x + i - 1, position.y + j - 1);
+                if (found)
+                    return found;
+            }
+        }
+    }
+
+    return found;
+}
+
+// ------------ RABBIT BEHAVIOUR ----------------
+
+// Returns the pixel of a plant near the rabbit, or (-1, -1) if there is none
+Vector2i atPlant(Vector2f position)
+{
+    for (int i = 0; i < 5; i++)
+    {
+        for (int j = 0; j < 5; j++)
+        {
+            if (checkPositionInBlueprint(plantLayer, position.x + i - 2, position.y + j - 2))
+            {
+                return Vector2i(position.x + i - 2, position.y + j - 2);
+            }
+        }
+    }
+    return Vector2i(-1, -1);
+}
+
+// Plans the tick of rabbit i from the current snapshot of the world (safe to run in parallel).
+// Hunger, thirst and reproductive urge have already been increased for this tick.
+AnimalIntent updateRabbit(int i)
+{
+    Vector2f position = rabbits.position[i];
+
+    AnimalIntent intent = {};
+    intent.fromPixel = Vector2i(floor(position.x), floor(position.y));
+
+    // An urge only matters once it is past half its maximum, and until then nothing around changes
+    // what the rabbit does. The levels only grow by constant deltas, so most ticks of most rabbits
+    // need no scan at all, and the ones that do only look for what they are after.
+    bool hungry = rabbits.hungerLevel[i] > (float)(rabbitMaxHunger / 2);
+    bool thirsty = rabbits.thirstLevel[i] > (float)(rabbitMaxThirst / 2);
+    bool wantsMate = rabbits.reproductiveUrge[i] > (float)(rabbitMaxReproductiveUrge / 2);
+
+    // Scanning surroundings to take note of everything
+    // Plants and mates are looked up in the spatial index
+    ProfileScope scanTimer(profileScan);
+    Vector2f closestFoodSource = hungry ? findNearestInSpatialIndex(plantLayer, position, rabbitVision, false) : Vector2f(-1, -1);
+    Vector2f closestMate = wantsMate ? findNearestInSpatialIndex(rabbitLayer, position, rabbitVision, true) : Vector2f(-1, -1);
+
+    // And the closest water comes straight from the water field
+    Vector2f closestWaterSource = thirsty ? findNearestWater(position, rabbitVision) : Vector2f(-1, -1);
+    scanTimer.stop();
+
+    // Now checking where to go to next
+    // (Food is walked to along the plant flow field, so lakes are walked around instead of into)
+    uint8_t flow = noFlow;
+
+    // If hunger level is high then set next destination as food (if available)
+    if (hungry && closestFoodSource != Vector2f(-1, -1))
+    {
+        rabbits.headedTo[i] = closestFoodSource;
+        flow = plantFlowAt(position);
+
+        Vector2i plant = atPlant(position);
+
+        // The plant loses a bite (and the rabbit is fed) once the tick is committed, if there is still food on it
+        if (plant.x >= 0)
+        {
+            intent.eatsPlant = true;
+            intent.plantPixel = plant;
+        }
+    }
+    // Else if thirst level is high then set next destination as water (if available)
+    else if (thirsty && closestWaterSource != Vector2f(-1, -1))
+    {
+        rabbits.headedTo[i] = closestWaterSource;
+
+        if (atWater(position))
+        {
+            rabbits.thirstLevel[i] = 0;
+        }
+    }
+    // Else if reprodcutive urge is high then set next destination as mate (if available)
+    else if (wantsMate && closestMate != Vector2f(-1, -1))
+    {
+        rabbits.headedTo[i] = closestMate;
+
+        if (atMate(rabbitLayer, position))
+        {
+            rabbits.reproductiveUrge[i] = 0;
+            // CREATE BABY (once the tick is committed)
+            intent.givesBirth = true;
+        }
+    }
+    // If all urges satisfied, then just roam randomly
+    else
+    {
+        roam(rabbits, i);
+    }
+
+    // Kill if too much hunger or thirst (a rabbit at a plant only starves if the plant runs out before its turn).
+    // A dead rabbit takes no bite, so the plant is left for the living.
+    bool starving = rabbits.hungerLevel[i] > rabbitMaxHunger && !intent.eatsPlant;
+
+    if (starving || rabbits.thirstLevel[i] > rabbitMaxThirst)
+    {
+        intent.eatsPlant = false;
+        return dieInPlace(intent, starving ? diedOfHunger : diedOfThirst);
+    }
+
+    // Move towards the next point (headed to)
+    moveAnimal(rabbits, i, flow);
+
+    intent.toPixel = Vector2i(floor(rabbits.position[i].x), floor(rabbits.position[i].y));
+    return intent;
+}
+
+// ------------ WOLF BEHAVIOUR ----------------
+// Same as above except food is rabbit instead of plant and mate is fox instead of rabbit
+
+// Returns the rabbit standing on the wolf's pixel (an invalid handle if there is none)
+EntityHandle atRabbit(Vector2f position)
+{
+    if (checkPositionInBlueprint(rabbitLayer, position.x, position.y))
+    {
+        return findInSpatialIndex(rabbitLayer, position.x, position.y);
+    }
+
+    return EntityHandle();
+}
+
+AnimalIntent updateWolf(int i)
+{
+    Vector2f position = wolves.position[i];
+
+    AnimalIntent intent = {};
+    intent.fromPixel = Vector2i(floor(position.x), floor(position.y));
+
+    // Same as rabbits, only what the wolf is after is looked for
+    bool hungry = wolves.hungerLevel[i] > (float)(wolfMaxHunger / 2);
+    bool thirsty = wolves.thirstLevel[i] > (float)(wolfMaxThirst / 2);
+    bool wantsMate = wolves.reproductiveUrge[i] > (float)(wolfMaxReproductiveUrge / 2);
+
+    // Rabbits and mates are looked up in the spatial index
+    ProfileScope scanTimer(profileScan);
+    Vector2f closestFoodSource = hungry ? findNearestInSpatialIndex(rabbitLayer, position, wolfVision, false) : Vector2f(-1, -1);
+    Vector2f closestMate = wantsMate ? findNearestInSpatialIndex(wolfLayer, position, wolfVision, true) : Vector2f(-1, -1);
+
+    // And the closest water comes straight from the water field
+    Vector2f closestWaterSource = thirsty ? findNearestWater(position, wolfVision) : Vector2f(-1, -1);
+    scanTimer.stop();
+
+    // If hunger level is down then check for plant before roaming
+    if (hungry && closestFoodSource != Vector2f(-1, -1))
+    {
+        wolves.headedTo[i] = closestFoodSource;
+
+        EntityHandle prey = atRabbit(position);
+
+        // The wolf is only fed once the tick is committed, if no other wolf got the rabbit first
+        if (prey.slot != UINT32_MAX)
+        {
+            intent.eatsRabbit = true;
+            intent.prey = prey;
+        }
+    }
+    else if (thirsty && closestWaterSource != Vector2f(-1, -1))
+    {
+        wolves.headedTo[i] = closestWaterSource;
+
+        if (atWater(position))
+        {
+            wolves.thirstLevel[i] = 0;
+        }
+    }
+    else if (wantsMate && closestMate != Vector2f(-1, -1))
+    {
+        wolves.headedTo[i] = closestMate;
+
+        if (atMate(wolfLayer, position))
+        {
+            wolves.reproductiveUrge[i] = 0;
+            // CREATE BABY
+            intent.givesBirth = true;
+        }
+    }
+    else
+    {
+        roam(wolves, i);
+    }
+
+    // Kill if too much hunger (a wolf that caught a rabbit only starves if it loses it to another wolf).
+    // A dead wolf eats nothing, so its rabbit lives.
+    bool starving = wolves.hungerLevel[i] > wolfMaxHunger && !intent.eatsRabbit;
+
+    if (starving || wolves.thirstLevel[i] > wolfMaxThirst)
+    {
+        intent.eatsRabbit = false;
+        return dieInPlace(intent, starving ? diedOfHunger : diedOfThirst);
+    }
+
+    moveAnimal(wolves, i);
+
+    intent.toPixel = Vector2i(floor(wolves.position[i].x), floor(wolves.position[i].y));
+    return intent;
+}
+
+// ------------ ASSET FUNCTIONS ----------------
+
+// Fonts and textures loaded so far, by file path
+map<string, Font> loadedFonts;
+map<string, Texture> loadedTextures;
+
+// Returns the font at the path, it is only read from disk the first time
+const Font &getFont(const string &path)
+{
+    map<string, Font>::iterator it = loadedFonts.find(path);
+
+    if (it == loadedFonts.end())
+    {
+        it = loadedFonts.emplace(path, Font()).first;
+        it->second.loadFromFile(path);
+    }
+
+    return it->second;
+}
+
+// Returns the image at the path as a texture, it is only decoded and uploaded the first time
+const Texture &getTexture(const string &path)
+{
+    map<string, Texture>::iterator it = loadedTextures.find(path);
+
+    if (it == loadedTextures.end())
+    {
+        it = loadedTextures.emplace(path, Texture()).first;
+        it->second.loadFromFile(path);
+    }
+
+    return it->second;
+}
+
+// ------------ SCREEN FUNCTIONS ----------------
+
+// Returns the pixels of the world under the camera
+IntRect cameraRect()
+{
+    Vector2f center = camera.getCenter();
+    Vector2f size = camera.getSize();
+
+    return IntRect((int)floor(center.x - size.x / 2), (int)floor(center.y - size.y / 2), (int)size.x, (int)size.y);
+}
+
+// Moves the camera by the given amount, without letting it leave the world
+void moveCamera(float dx, float dy)
+{
+    Vector2f center = camera.getCenter() + Vector2f(dx, dy);
+    Vector2f halfSize = camera.getSize() / 2.f;
+
+    center.x = max(halfSize.x, min(worldWidth - halfSize.x, center.x));
+    center.y = max(halfSize.y, min(worldHeight - halfSize.y, center.y));
+
+    camera.setCenter(center);
+}
+
+void displayLoadingScreen(RenderWindow *window)
+{
+
+    // Creating and setting text
+    Text headingText;
+    headingText.setFont(getFont("assets/fonts/8-bit-hud.ttf"));
+    headingText.setString("Generating\nTerrain...");
+
+    headingText.setCharacterSize(25);
+
+    sf::FloatRect bounds = headingText.getLocalBounds();
+    headingText.setOrigin(-bounds.left + bounds.width / 2.f, -bounds.top + bounds.height / 2.f);
+
+    headingText.setPosition(Vector2f(window->getSize().x / 2, window->getSize().y / 2));
+    headingText.setFillColor(Color::White);
+
+    // Drawing and displaying loading screen text
+    window->clear();
+    window->draw(headingText);
+
+    window->display();
+}
+
+// The population bar is kept between frames, and its text is only rebuilt when a population changes
+RectangleShape populationBar(Vector2f(width, 30));
+Text populationText;
+Text speedText;
+int shownRabbits = -1;
+int shownWolves = -1;
+int shownSpeed = -1;
+
+void drawPopulationStats(RenderWindow *window)
+{
+    ProfileScope timer(profileDrawStats);
+
+    // Drawing a translucent rectangle and the number of population
+    // as text on top of it.
+
+    if (shownRabbits != rabbits.size() || shownWolves != wolves.size())
+    {
+        shownRabbits = rabbits.size();
+        shownWolves = wolves.size();
+
+        String textString = "Rabbits Alive: " + to_string(shownRabbits) + "                                                                                                                                                                     Wolves Alive: " + to_string(shownWolves);
+
+        populationBar.setFillColor(Color(0, 0, 0, 255 * 0.9));
+        populationText.setFont(getFont("assets/fonts/Jersey15-Regular.ttf"));
+        populationText.setFillColor(Color::White);
+
+        populationText.setString(textString);
+        populationText.setCharacterSize(20);
+
+        populationBar.setPosition(Vector2f(0, 0));
+        populationText.setPosition(Vector2f((width / 2) - (populationText.getLocalBounds().width / 2), (populationText.getLocalBounds().height - 10)));
+    }
+
+    // The simulation speed goes in the middle of the bar
+    if (shownSpeed != simulationSpeeds[speedLevel])
+    {
+        shownSpeed = simulationSpeeds[speedLevel];
+
+        speedText.setFont(getFont("assets/fonts/Jersey15-Regular.ttf"));
+        speedText.setFillColor(Color::White);
+
+        speedText.setString("Speed: " + to_string(shownSpeed) + "x");
+        speedText.setCharacterSize(20);
+
+        speedText.setPosition(Vector2f((width / 2) - (speedText.getLocalBounds().width / 2), (speedText.getLocalBounds().height - 10)));
+    }
+
+    window->draw(populationBar);
+    window->draw(populationText);
+    window->draw(speedText);
+}
+
+// The profile overlay (F3): p50 and p99 of every phase over the last profileWindow frames, under the population bar
+RectangleShape profilePanel;
+Text profileColumns[3];
+
+void drawProfile(RenderWindow *window)
+{
+    string columns[3] = {"phase\n", "p50 us\n", "p99 us\n"};
+    float columnLeft[3] = {10, 150, 225};
+
+    for (int phase = 0; phase < numProfilePhases; phase++)
+    {
+        columns[0] += string(profilePhaseNames[phase]) + "\n";
+        columns[1] += to_string(profilePercentile((ProfilePhase)phase, 50)) + "\n";
+        columns[2] += to_string(profilePercentile((ProfilePhase)phase, 99)) + "\n";
+    }
+
+    profilePanel.setSize(Vector2f(300, (numProfilePhases + 1) * 18 + 10));
+    profilePanel.setPosition(Vector2f(0, 30));
+    profilePanel.setFillColor(Color(0, 0, 0, 255 * 0.7));
+    window->draw(profilePanel);
+
+    for (int c = 0; c < 3; c++)
+    {
+        profileColumns[c].setFont(getFont("assets/fonts/Jersey15-Regular.ttf"));
+        profileColumns[c].setFillColor(Color::White);
+        profileColumns[c].setCharacterSize(16);
+        profileColumns[c].setString(columns[c]);
+        profileColumns[c].setPosition(Vector2f(columnLeft[c], 35));
+
+        window->draw(profileColumns[c]);
+    }
+}
+
+bool onIntro = true;
+
+// The intro image is only loaded once, the first time the intro is drawn
+Sprite introSprite;
+
+void drawIntroScreen(RenderWindow *window)
+{
+    // Draw the intro menu image
+    if (introSprite.getTexture() == nullptr)
+    {
+        introSprite.setTexture(getTexture("assets/images/IntroScreen.png"));
+        introSprite.setScale(0.5, 0.5);
+    }
 
     window->draw(introSprite);
 }
 
-// ------------ TERRAIN FUNCTIONS ----------------
+// Packs the rabbit and wolf images side by side into the texture atlas.
+// Done once at startup, so births never touch the disk or the GPU.
+void buildTextureAtlas()
+{
+    Image rabbitImage;
+    rabbitImage.loadFromFile("assets/images/RabbitFace.png");
+
+    Image wolfImage;
+    wolfImage.loadFromFile("assets/images/WolfFace.png");
+
+    rabbitAtlasRect = IntRect(0, 0, rabbitImage.getSize().x, rabbitImage.getSize().y);
+    wolfAtlasRect = IntRect(rabbitAtlasRect.width, 0, wolfImage.getSize().x, wolfImage.getSize().y);
+
+    Image atlasImage;
+    atlasImage.create(wolfAtlasRect.left + wolfAtlasRect.width, max(rabbitAtlasRect.height, wolfAtlasRect.height), Color(0, 0, 0, 0));
+    atlasImage.copy(rabbitImage, rabbitAtlasRect.left, rabbitAtlasRect.top);
+    atlasImage.copy(wolfImage, wolfAtlasRect.left, wolfAtlasRect.top);
+
+    atlasTexture.loadFromImage(atlasImage);
+}
+
+// Writes quad number i of the vertex array: a rectangle of the given size centered on
+// the position, showing the given rectangle of the atlas
+void setQuad(VertexArray &vertices, int i, Vector2f center, Vector2f size, IntRect atlasRect)
+{
+    Vertex *quad = &vertices[i * 4];
+
+    float left = center.x - size.x / 2;
+    float top = center.y - size.y / 2;
+
+    quad[0].position = Vector2f(left, top);
+    quad[1].position = Vector2f(left + size.x, top);
+    quad[2].position = Vector2f(left + size.x, top + size.y);
+    quad[3].position = Vector2f(left, top + size.y);
+
+    quad[0].texCoords = Vector2f(atlasRect.left, atlasRect.top);
+    quad[1].texCoords = Vector2f(atlasRect.left + atlasRect.width, atlasRect.top);
+    quad[2].texCoords = Vector2f(atlasRect.left + atlasRect.width, atlasRect.top + atlasRect.height);
+    quad[3].texCoords = Vector2f(atlasRect.left, atlasRect.top + atlasRect.height);
+}
+
+// Where the animal at the index is drawn: tickFraction of the way along its last move
+Vector2f drawnPosition(const AnimalStore &animals, int index)
+{
+    return animals.lastPosition[index] + (animals.position[index] - animals.lastPosition[index]) * tickFraction;
+}
+
+// ------------ TERRAIN FUNCTIONS ----------------
+
+// One dimensional squared distance transform (Felzenszwalb & Huttenlocher) of f along a row.
+// Writes the squared distance of every x to its closest site q (a finite f[q]) as (x - q)^2 + f[q]
+// and that q into closest (or noWaterDistance and -1 when the row has no sites). Runs in O(n).
+void distanceTransform1D(const int32_t *f, int n, int32_t *distance, int32_t *closest, int *v, double *z)
+{
+    // Building the lower envelope of the parabolas rooted at every site
+    int k = -1;
+
+    for (int q = 0; q < n; q++)
+    {
+        if (f[q] == noWaterDistance)
+        {
+            continue;
+        }
+
+        double s = -INFINITY;
+
+        while (k >= 0)
+        {
+            s = ((double)f[q] + (double)q * q - (double)f[v[k]] - (double)v[k] * v[k]) / (2.0 * (q - v[k]));
+
+            if (s > z[k])
+            {
+                break;
+            }
+
+            k--;
+        }
+
+        if (k < 0)
+        {
+            s = -INFINITY;
+        }
+
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = INFINITY;
+    }
+
+    // Reading the distances off the envelope
+    for (int x = 0, j = 0; x < n; x++)
+    {
+        if (k < 0)
+        {
+            distance[x] = noWaterDistance;
+            closest[x] = -1;
+            continue;
+        }
+
+        while (z[j + 1] < x)
+        {
+            j++;
+        }
+
+        distance[x] = (x - v[j]) * (x - v[j]) + f[v[j]];
+        closest[x] = v[j];
+    }
+}
+
+// Returns true if the pixel is land, straight from the noise (for chunks that are not loaded)
+bool isLandInNoise(int x, int y)
+{
+    // Values above 0.4 are land, rest are water
+    return terrainNoise.octave2D_01((x * 0.01), (y * 0.01), 1, 0.2) > 0.4;
+}
+
+// Computes the exact euclidean distance transform of the water pixels (set in water) of a tile reaching
+// waterApron past every edge of the chunk, and keeps the chunk's part of it along with the closest water pixel.
+// Columns are done first, then rows, so the whole tile takes linear time.
+void computeChunkWaterField(Chunk &chunk, const vector<uint8_t> &water, int tileSize)
+{
+    int tileLeft = chunk.left - waterApron;
+    int tileTop = chunk.top - waterApron;
+
+    // Closest water row within each column, for every pixel of the tile. Every water pixel is a site at
+    // distance 0, so that is just the nearest water above or below (above on a tie, as distanceTransform1D
+    // picks), found for all columns at once by sweeping the rows down and then up.
+    vector<int32_t> columnDistance(tileSize * tileSize);
+    vector<int32_t> columnClosestY(tileSize * tileSize);
+
+    vector<int32_t> nearest(tileSize, -1);
+
+    for (int y = 0; y < tileSize; y++)
+    {
+        for (int x = 0; x < tileSize; x++)
+        {
+            nearest[x] = water[y * tileSize + x] ? y : nearest[x];
+            columnClosestY[y * tileSize + x] = nearest[x];
+        }
+    }
+
+    fill(nearest.begin(), nearest.end(), -1);
+
+    for (int y = tileSize - 1; y >= 0; y--)
+    {
+        for (int x = 0; x < tileSize; x++)
+        {
+            int cell = y * tileSize + x;
+            int above = columnClosestY[cell];
+
+            nearest[x] = water[cell] ? y : nearest[x];
+
+            int q = above >= 0 && (nearest[x] < 0 || y - above <= nearest[x] - y) ? above : nearest[x];
+
+            columnClosestY[cell] = q;
+            columnDistance[cell] = q < 0 ? noWaterDistance : (y - q) * (y - q);
+        }
+    }
+
+    vector<int32_t> distance(tileSize), closest(tileSize);
+    vector<int> v(tileSize);
+    vector<double> z(tileSize + 1);
+
+    // Combining the columns along the rows of the chunk, the closest site q of a row is the column the water is in
+    for (int y = 0; y < chunkSize; y++)
+    {
+        int row = (y + waterApron) * tileSize;
+
+        distanceTransform1D(&columnDistance[row], tileSize, distance.data(), closest.data(), v.data(), z.data());
+
+        for (int x = 0; x < chunkSize; x++)
+        {
+            int cell = y * chunkSize + x;
+            int q = closest[x + waterApron];
+
+            chunk.waterDistanceSquared[cell] = distance[x + waterApron];
+            chunk.nearestWater[cell] = q < 0 ? Vector2i(-1, -1) : Vector2i(tileLeft + q, tileTop + columnClosestY[row + q]);
+        }
+    }
+}
+
+// Evaluates the noise over a chunk's area into its land mask
+void computeLandMask(LandMask &mask, int left, int top)
+{
+    // Every pixel gets exactly octave2D_01((x * 0.01), (y * 0.01), 1, 0.2), the same as isLandInNoise
+    vector<double> noise(chunkSize * chunkSize);
+    terrainNoise.fillGrid2D(left, top, 0.01, chunkSize, chunkSize, 1, 0.2, noise.data(), chunkSize);
+
+    memset(mask.bits, 0, sizeof(mask.bits));
+
+    for (int cell = 0; cell < chunkSize * chunkSize; cell++)
+    {
+        // Values above 0.4 are land, rest are water
+        if (noise[cell] > 0.4)
+        {
+            mask.bits[cell / 64] |= (uint64_t)1 << (cell % 64);
+        }
+    }
+}
+
+// Returns true if the pixel is inside the world and land, from the land mask of its chunk (which has to exist)
+bool isLandInMask(int x, int y)
+{
+    if (!isWithinBounds(x, y))
+    {
+        return false;
+    }
+
+    const LandMask &mask = *landMasks[(y / chunkSize) * chunksAcross + (x / chunkSize)];
+    int cell = (y % chunkSize) * chunkSize + (x % chunkSize);
+
+    return (mask.bits[cell / 64] >> (cell % 64)) & 1;
+}
+
+// Generates a chunk's terrain from the land masks of it and its neighbours: land and water in its blueprint
+// and bitmap, and its water field. Only writes to the chunk itself, so several chunks can be generated at once.
+void generateChunk(Chunk &chunk)
+{
+    int tileSize = chunkSize + 2 * waterApron;
+    int tileLeft = chunk.left - waterApron;
+    int tileTop = chunk.top - waterApron;
+
+    vector<uint8_t> water(tileSize * tileSize);
+
+    // Water only counts inside the world
+    for (int j = 0; j < tileSize; j++)
+    {
+        for (int i = 0; i < tileSize; i++)
+        {
+            int x = tileLeft + i;
+            int y = tileTop + j;
+
+            water[j * tileSize + i] = isWithinBounds(x, y) && !isLandInMask(x, y);
+        }
+    }
+
+    memcpy(chunk.terrainBits, landMasks[(chunk.top / chunkSize) * chunksAcross + chunk.left / chunkSize]->bits, sizeof(chunk.terrainBits));
+
+    for (int localY = 0; localY < chunkSize; localY++)
+    {
+        for (int localX = 0; localX < chunkSize; localX++)
+        {
+            if (!isWithinBounds(chunk.left + localX, chunk.top + localY))
+            {
+                continue;
+            }
+
+            int cell = localY * chunkSize + localX;
+            bool land = (chunk.terrainBits[cell / 64] >> (cell % 64)) & 1;
+
+            chunk.positionBlueprint[cell] |= (uint8_t)(1 << (land ? landLayer : waterLayer));
+
+            if (land)
+            {
+                chunk.landCells[(localY / spatialCellSize) * chunkSpatialCells + localX / spatialCellSize].push_back(cell);
+            }
+        }
+    }
+
+    computeChunkWaterField(chunk, water, tileSize);
+}
+
+// Seeds the terrain noise from the world seed and empties the world (no chunk is loaded, and no animal is left)
+void resetWorld()
+{
+    terrainSeed = (siv::PerlinNoise::seed_type)RandomStream(terrainStream, 0).next();
+    terrainNoise.reseed(terrainSeed);
+
+    chunksAcross = (worldWidth + chunkSize - 1) / chunkSize;
+    chunksDown = (worldHeight + chunkSize - 1) / chunkSize;
+    chunks.clear();
+    chunks.resize(chunksAcross * chunksDown);
+    loadedChunks.clear();
+    landMasks.clear();
+    landMasks.resize(chunksAcross * chunksDown);
+
+    rabbits = AnimalStore();
+    wolves = AnimalStore();
+
+    // Animals look for water as far as they can see
+    waterApron = max(rabbitVision, wolfVision);
+
+    // Starting in the middle of the world
+    camera.setCenter(worldWidth / 2.f, worldHeight / 2.f);
+}
+
+// To generate a terrain using perlin noise. Only the seed is picked here, the chunks are
+// generated from it as they are needed (starting with the ones under the camera).
+void generateTerrain()
+{
+    resetWorld();
+
+    IntRect view = cameraRect();
+    loadChunksIn(view.left, view.top, view.left + view.width - 1, view.top + view.height - 1);
+
+    terrainGenerated = true;
+
+    // Printing the world seed (on stderr, so it stays out of headless output), --seed with it repeats the run
+    cerr << "\nSeed: " << worldSeed << endl;
+}
+
+// ------------ CHUNK FUNCTIONS ----------------
+
+// Returns the chunk the pixel is in, or null if that chunk is not loaded (or the pixel is outside the world)
+Chunk *findChunk(int x, int y)
+{
+    if (x < 0 || y < 0 || x >= worldWidth || y >= worldHeight)
+    {
+        return nullptr;
+    }
+
+    return chunks[(y / chunkSize) * chunksAcross + (x / chunkSize)].get();
+}
+
+// Generates the chunks with the given indices in parallel, then adds them to the world one at a time
+// in order, spawning their plants unless the plants come from somewhere else (a snapshot)
+void addChunks(const vector<int> &indices, bool spawnPlants)
+{
+    // A chunk's water field reaches into its neighbours, so the land masks of the chunks and
+    // their neighbours are made first (the ones the noise was not evaluated for yet)
+    vector<int> maskIndices;
+
+    for (int i = 0; i < indices.size(); i++)
+    {
+        int chunkX = indices[i] % chunksAcross;
+        int chunkY = indices[i] / chunksAcross;
+
+        for (int y = max(0, chunkY - 1); y <= min(chunksDown - 1, chunkY + 1); y++)
+        {
+            for (int x = max(0, chunkX - 1); x <= min(chunksAcross - 1, chunkX + 1); x++)
+            {
+                if (!landMasks[y * chunksAcross + x])
+                {
+                    maskIndices.push_back(y * chunksAcross + x);
+                }
+            }
+        }
+    }
+
+    sort(maskIndices.begin(), maskIndices.end());
+    maskIndices.erase(unique(maskIndices.begin(), maskIndices.end()), maskIndices.end());
+
+    vector<unique_ptr<LandMask>> masks(maskIndices.size());
+
+    threadPool.parallelFor(maskIndices.size(), [&](int i)
+    {
+        masks[i] = make_unique<LandMask>();
+        computeLandMask(*masks[i], (maskIndices[i] % chunksAcross) * chunkSize, (maskIndices[i] / chunksAcross) * chunkSize);
+    }, 1);
+
+    for (int i = 0; i < maskIndices.size(); i++)
+    {
+        landMasks[maskIndices[i]] = move(masks[i]);
+    }
+
+    vector<unique_ptr<Chunk>> generated(indices.size());
+
+    threadPool.parallelFor(indices.size(), [&](int i)
+    {
+        generated[i] = make_unique<Chunk>();
+        generated[i]->left = (indices[i] % chunksAcross) * chunkSize;
+        generated[i]->top = (indices[i] / chunksAcross) * chunkSize;
+
+        generateChunk(*generated[i]);
+    }, 1);
+
+    for (int i = 0; i < indices.size(); i++)
+    {
+        Chunk &chunk = *generated[i];
+        chunk.lastNeededTick = simulationTick;
+
+        // Textures can only be made on the main thread, and the whole chunk is painted when it is first drawn
+        if (!headless)
+        {
+            chunk.terrainTexture.create(chunkSize, chunkSize);
+            chunk.changedPixels = IntRect(0, 0, chunkSize, chunkSize);
+        }
+
+        chunks[indices[i]] = move(generated[i]);
+        loadedChunks.push_back(indices[i]);
+
+        if (spawnPlants)
+        {
+            spawnChunkPlants(chunk, indices[i]);
+        }
+    }
+}
+
+// Loads (if needed) and marks as needed every chunk overlapping the rectangle of pixels from
+// (left, top) to (right, bottom)
+void loadChunksIn(int left, int top, int right, int bottom)
+{
+    int minChunkX = max(0, left) / chunkSize;
+    int maxChunkX = min(worldWidth - 1, right) / chunkSize;
+    int minChunkY = max(0, top) / chunkSize;
+    int maxChunkY = min(worldHeight - 1, bottom) / chunkSize;
+
+    int numMissing = 0;
+
+    for (int chunkY = minChunkY; chunkY <= maxChunkY; chunkY++)
+    {
+        for (int chunkX = minChunkX; chunkX <= maxChunkX; chunkX++)
+        {
+            Chunk *chunk = chunks[chunkY * chunksAcross + chunkX].get();
+
+            if (chunk)
+            {
+                chunk->lastNeededTick = simulationTick;
+            }
+            else
+            {
+                numMissing++;
+            }
+        }
+    }
+
+    if (numMissing == 0)
+    {
+        return;
+    }
+
+    vector<int> missing;
+    missing.reserve(numMissing);
+
+    for (int chunkY = minChunkY; chunkY <= maxChunkY; chunkY++)
+    {
+        for (int chunkX = minChunkX; chunkX <= maxChunkX; chunkX++)
+        {
+            if (!chunks[chunkY * chunksAcross + chunkX])
+            {
+                missing.push_back(chunkY * chunksAcross + chunkX);
+            }
+        }
+    }
+
+    addChunks(missing, true);
+}
+
+// Loads the chunks within radius of a position
+void loadChunksAround(Vector2f position, int radius)
+{
+    int x = floor(position.x);
+    int y = floor(position.y);
+
+    loadChunksIn(x - radius, y - radius, x + radius, y + radius);
+}
+
+// Returns the chunk the pixel is in, loading it if it is not (the pixel has to be inside the world)
+Chunk &needChunk(int x, int y)
+{
+    loadChunksIn(x, y, x, y);
+
+    return *chunks[(y / chunkSize) * chunksAcross + (x / chunkSize)];
+}
+
+// Returns a random land pixel of the spatial index cell the pixel is in, or (-1, -1) if it has
+// no land (or its chunk is not loaded)
+Vector2i randomLandPixelNear(int x, int y, RandomStream &random)
+{
+    Chunk *chunk = findChunk(x, y);
+
+    if (chunk)
+    {
+        const vector<uint16_t> &land = chunk->landCells[((y - chunk->top) / spatialCellSize) * chunkSpatialCells + (x - chunk->left) / spatialCellSize];
+
+        if (!land.empty())
+        {
+            int cell = land[random.below(land.size())];
+
+            return Vector2i(chunk->left + cell % chunkSize, chunk->top + cell / chunkSize);
+        }
+    }
+
+    return Vector2i(-1, -1);
+}
+
+// Returns a random land pixel of the chunk, or (-1, -1) if it has no land
+Vector2i randomLandPixel(const Chunk &chunk, RandomStream &random)
+{
+    int numLand = 0;
+
+    for (int region = 0; region < chunkSpatialCells * chunkSpatialCells; region++)
+    {
+        numLand += chunk.landCells[region].size();
+    }
+
+    if (numLand == 0)
+    {
+        return Vector2i(-1, -1);
+    }
+
+    int pick = random.below(numLand);
+
+    for (int region = 0;; region++)
+    {
+        if (pick < chunk.landCells[region].size())
+        {
+            int cell = chunk.landCells[region][pick];
+
+            return Vector2i(chunk.left + cell % chunkSize, chunk.top + cell / chunkSize);
+        }
+
+        pick -= chunk.landCells[region].size();
+    }
+}
+
+// Returns every land pixel inside the area (loading the chunks it covers), to spawn on
+vector<Vector2i> landPixelsIn(IntRect area)
+{
+    int right = min(worldWidth - 1, area.left + area.width - 1);
+    int bottom = min(worldHeight - 1, area.top + area.height - 1);
+
+    loadChunksIn(area.left, area.top, right, bottom);
+
+    vector<Vector2i> land;
+
+    for (int chunkY = max(0, area.top) / chunkSize; chunkY <= bottom / chunkSize; chunkY++)
+    {
+        for (int chunkX = max(0, area.left) / chunkSize; chunkX <= right / chunkSize; chunkX++)
+        {
+            const Chunk &chunk = *chunks[chunkY * chunksAcross + chunkX];
+
+            for (int region = 0; region < chunkSpatialCells * chunkSpatialCells; region++)
+            {
+                for (int i = 0; i < chunk.landCells[region].size(); i++)
+                {
+                    int cell = chunk.landCells[region][i];
+                    Vector2i pixel(chunk.left + cell % chunkSize, chunk.top + cell / chunkSize);
+
+                    if (area.contains(pixel.x, pixel.y))
+                    {
+                        land.push_back(pixel);
+                    }
+                }
+            }
+        }
+    }
+
+    return land;
+}
+
+// Evicts chunks that have not been needed for a while (and have no animals on them), but only
+// while more than maxLoadedChunks are loaded. Their plants go with them and grow back from the
+// seed if the chunk is ever loaded again.
+void evictChunks()
+{
+    ProfileScope timer(profileEvictChunks);
+
+    for (int i = 0; i < loadedChunks.size() && loadedChunks.size() > maxLoadedChunks;)
+    {
+        Chunk &chunk = *chunks[loadedChunks[i]];
+
+        if (chunk.numAnimals > 0 || simulationTick - chunk.lastNeededTick <= chunkEvictTicks)
+        {
+            i++;
+            continue;
+        }
+
+        removeChunkPlants(chunk);
+
+        chunks[loadedChunks[i]].reset();
+        loadedChunks[i] = loadedChunks.back();
+        loadedChunks.pop_back();
+    }
+}
+
+// Draws the terrain of every chunk under the camera (loading the ones that are not loaded yet)
+void drawTerrain(RenderWindow *window)
+{
+    ProfileScope timer(profileDrawTerrain);
+
+    IntRect view = cameraRect();
+    loadChunksIn(view.left, view.top, view.left + view.width - 1, view.top + view.height - 1);
+
+    int minChunkX = max(0, view.left) / chunkSize;
+    int maxChunkX = min(worldWidth - 1, view.left + view.width - 1) / chunkSize;
+    int minChunkY = max(0, view.top) / chunkSize;
+    int maxChunkY = min(worldHeight - 1, view.top + view.height - 1) / chunkSize;
+
+    Sprite chunkSprite;
+
+    for (int chunkY = minChunkY; chunkY <= maxChunkY; chunkY++)
+    {
+        for (int chunkX = minChunkX; chunkX <= maxChunkX; chunkX++)
+        {
+            Chunk &chunk = *chunks[chunkY * chunksAcross + chunkX];
+
+            if (chunk.changedPixels.width > 0)
+            {
+                repaintChangedPixels(chunk);
+            }
+
+            chunkSprite.setTexture(chunk.terrainTexture);
+            chunkSprite.setPosition(chunk.left, chunk.top);
+            window->draw(chunkSprite);
+        }
+    }
+}
+
+// ------------ POSITION BLUEPRINT FUNCTIONS ----------------
+
+// Add the layer to the blueprint at specific pixel (loading its chunk if needed)
+void addToPositionBlueprint(BlueprintLayer layer, int x, int y)
+{
+    if (isWithinBounds(x, y))
+    {
+        Chunk &chunk = needChunk(x, y);
+        int cell = (y - chunk.top) * chunkSize + (x - chunk.left);
+
+        // Land and water are set once, occupants are counted so they can stack
+        if (layer >= firstOccupantLayer)
+        {
+            chunk.positionBlueprintCount[layer - firstOccupantLayer][cell]++;
+        }
+
+        if (layer == rabbitLayer || layer == wolfLayer)
+        {
+            chunk.numAnimals++;
+        }
+
+        chunk.positionBlueprint[cell] |= (uint8_t)(1 << layer);
+    }
+}
+
+// Checks if the layer exists in the blueprint at the specific pixel (never for chunks that are not loaded)
+bool checkPositionInBlueprint(BlueprintLayer layer, int x, int y)
+{
+    Chunk *chunk = isWithinBounds(x, y) ? findChunk(x, y) : nullptr;
+
+    return chunk && ((chunk->positionBlueprint[(y - chunk->top) * chunkSize + (x - chunk->left)] >> layer) & 1);
+}
+
+// Remove the layer from the blueprint at specific pixel
+void removePositionFromBlueprint(BlueprintLayer layer, int x, int y)
+{
+    Chunk *chunk = isWithinBounds(x, y) ? findChunk(x, y) : nullptr;
+
+    if (chunk)
+    {
+        int cell = (y - chunk->top) * chunkSize + (x - chunk->left);
+
+        // Only clearing the bit once the last occupant of this layer has left the pixel
+        if (layer >= firstOccupantLayer)
+        {
+            uint16_t &count = chunk->positionBlueprintCount[layer - firstOccupantLayer][cell];
+
+            if (count == 0)
+            {
+                return;
+            }
+
+            if (layer == rabbitLayer || layer == wolfLayer)
+            {
+                chunk->numAnimals--;
+            }
+
+            if (--count > 0)
+            {
+                return;
+            }
+        }
+
+        chunk->positionBlueprint[cell] &= (uint8_t)~(1 << layer);
+    }
+}
+
+// ------------ SPATIAL INDEX FUNCTIONS ----------------
+
+// Returns the bucket of the chunk that holds the pixel
+vector<SpatialEntry> &spatialBucket(Chunk &chunk, BlueprintLayer layer, int x, int y)
+{
+    int cell = ((y - chunk.top) / spatialCellSize) * chunkSpatialCells + (x - chunk.left) / spatialCellSize;
+
+    return chunk.spatialIndex[layer - firstOccupantLayer][cell];
+}
+
+// Add an occupant (plant, rabbit or wolf) at the given pixel to its bucket. Animals must already be in
+// their store, which keeps track of where their entry is.
+void addToSpatialIndex(BlueprintLayer layer, int x, int y, EntityHandle handle)
+{
+    // Same bounds as the blueprint, so both always agree on who is in the world
+    if (isWithinBounds(x, y))
+    {
+        vector<SpatialEntry> &bucket = spatialBucket(needChunk(x, y), layer, x, y);
+        bucket.push_back({Vector2i(x, y), handle});
+
+        if (layer != plantLayer)
+        {
+            AnimalStore &animals = animalsOfLayer(layer);
+            animals.bucketSlot[animals.handles.indexOf(handle)] = bucket.size() - 1;
+        }
+    }
+}
+
+// Remove the occupant with the handle from the bucket of the given pixel. Animals are found
+// straight from their store, in constant time; plants (which only go with their chunk) are searched for.
+void removeFromSpatialIndex(BlueprintLayer layer, int x, int y, EntityHandle handle)
+{
+    Chunk *chunk = isWithinBounds(x, y) ? findChunk(x, y) : nullptr;
+
+    if (!chunk)
+    {
+        return;
+    }
+
+    vector<SpatialEntry> &bucket = spatialBucket(*chunk, layer, x, y);
+    int i = 0;
+
+    if (layer == plantLayer)
+    {
+        while (i < bucket.size() && bucket[i].handle != handle)
+        {
+            i++;
+        }
+
+        if (i == bucket.size())
+        {
+            return;
+        }
+    }
+    else
+    {
+        AnimalStore &animals = animalsOfLayer(layer);
+        i = animals.bucketSlot[animals.handles.indexOf(handle)];
+    }
+
+    // Order inside a bucket does not matter, so swap with the last one and pop
+    bucket[i] = bucket.back();
+    bucket.pop_back();
+
+    // The animal that was last in the bucket now sits where the removed one was
+    if (i < bucket.size() && layer != plantLayer)
+    {
+        AnimalStore &animals = animalsOfLayer(layer);
+        animals.bucketSlot[animals.handles.indexOf(bucket[i].handle)] = i;
+    }
+
+    // A crowd that has left gives its memory back
+    if (bucket.capacity() > 64 && bucket.size() * 4 < bucket.capacity())
+    {
+        shrinkCapacity(bucket, bucket.size() * 2);
+    }
+}
+
+// Returns an occupant of the layer standing exactly on the pixel (an invalid handle if there is none)
+EntityHandle findInSpatialIndex(BlueprintLayer layer, int x, int y)
+{
+    Chunk *chunk = isWithinBounds(x, y) ? findChunk(x, y) : nullptr;
+
+    if (chunk)
+    {
+        const vector<SpatialEntry> &bucket = spatialBucket(*chunk, layer, x, y);
+
+        for (int i = 0; i < bucket.size(); i++)
+        {
+            if (bucket[i].pixel == Vector2i(x, y))
+            {
+                return bucket[i].handle;
+            }
+        }
+    }
+
+    return EntityHandle();
+}
+
+// Returns the closest occupant of the layer within radius of the position, or (-1, -1) if there is none.
+// With skipOwnPixel the pixel the position is on is ignored (so an animal does not find itself).
+Vector2f findNearestInSpatialIndex(BlueprintLayer layer, Vector2f position, int radius, bool skipOwnPixel)
+{
+    Vector2f nearest(-1, -1);
+    float nearestDistance = (float)radius * radius;
+
+    int own_x = floor(position.x);
+    int own_y = floor(position.y);
+
+    // Only the buckets overlapping the square around the search circle can hold a match
+    int minCellX = max(0, (int)floor((position.x - radius) / spatialCellSize));
+    int maxCellX = min((worldWidth - 1) / spatialCellSize, (int)floor((position.x + radius) / spatialCellSize));
+    int minCellY = max(0, (int)floor((position.y - radius) / spatialCellSize));
+    int maxCellY = min((worldHeight - 1) / spatialCellSize, (int)floor((position.y + radius) / spatialCellSize));
+
+    for (int cellY = minCellY; cellY <= maxCellY; cellY++)
+    {
+        for (int cellX = minCellX; cellX <= maxCellX; cellX++)
+        {
+            Chunk *chunk = findChunk(cellX * spatialCellSize, cellY * spatialCellSize);
+
+            if (!chunk)
+            {
+                continue;
+            }
+
+            const vector<SpatialEntry> &bucket = spatialBucket(*chunk, layer, cellX * spatialCellSize, cellY * spatialCellSize);
+
+            for (int i = 0; i < bucket.size(); i++)
+            {
+                const Vector2i &pixel = bucket[i].pixel;
+
+                if (skipOwnPixel && pixel.x == own_x && pixel.y == own_y)
+                {
+                    continue;
+                }
+
+                float dx = pixel.x - position.x;
+                float dy = pixel.y - position.y;
+                float distance = dx * dx + dy * dy;
+
+                if (distance <= nearestDistance)
+                {
+                    nearestDistance = distance;
+                    nearest = Vector2f(pixel.x, pixel.y);
+                }
+            }
+        }
+    }
+
+    return nearest;
+}
+
+// ------------ WATER FIELD FUNCTIONS ----------------
+
+// Returns true if there is water within the given squared distance of the pixel
+bool isNearWater(int x, int y, int maxDistanceSquared)
+{
+    Chunk *chunk = isWithinBounds(x, y) ? findChunk(x, y) : nullptr;
+
+    return chunk && chunk->waterDistanceSquared[(y - chunk->top) * chunkSize + (x - chunk->left)] <= maxDistanceSquared;
+}
+
+// Returns the closest water pixel within radius of the position, or (-1, -1) if there is none
+Vector2f findNearestWater(Vector2f position, int radius)
+{
+    int x = floor(position.x);
+    int y = floor(position.y);
+
+    if (isNearWater(x, y, radius * radius))
+    {
+        Chunk *chunk = findChunk(x, y);
+        Vector2i water = chunk->nearestWater[(y - chunk->top) * chunkSize + (x - chunk->left)];
+
+        return Vector2f(water.x, water.y);
+    }
+
+    return Vector2f(-1, -1);
+}
+
+// ------------ FLOW FIELD FUNCTIONS ----------------
+
+// Breadth first search over the land of a tile reaching waterApron past every edge of the chunk, from the
+// seed pixels (as indices into the tile). Keeps the first step towards the closest seed for the chunk's pixels.
+void computeChunkFlow(const Chunk &chunk, const vector<uint8_t> &tileLand, vector<int> &seeds, int tileSize, uint8_t *flow)
+{
+    int tileLeft = chunk.left - waterApron;
+    int tileTop = chunk.top - waterApron;
+
+    // Step each reached pixel takes back towards the pixel it was reached from (seeds stay at noFlow)
+    vector<uint8_t> step(tileSize * tileSize, noFlow);
+    vector<uint8_t> reached(tileSize * tileSize, 0);
+
+    // Seeds in a fixed order, so that ties are broken the same way however the plants are stored
+    sort(seeds.begin(), seeds.end());
+    seeds.erase(unique(seeds.begin(), seeds.end()), seeds.end());
+
+    vector<int> queue = seeds;
+
+    for (int i = 0; i < queue.size(); i++)
+    {
+        reached[queue[i]] = 1;
+    }
+
+    for (int head = 0; head < queue.size(); head++)
+    {
+        int i = queue[head] % tileSize;
+        int j = queue[head] / tileSize;
+
+        for (int direction = 0; direction < 8; direction++)
+        {
+            int ni = i + flowStepX[direction];
+            int nj = j + flowStepY[direction];
+
+            if (ni < 0 || ni >= tileSize || nj < 0 || nj >= tileSize)
+            {
+                continue;
+            }
+
+            int neighbour = nj * tileSize + ni;
+
+            if (reached[neighbour] || !tileLand[neighbour])
+            {
+                continue;
+            }
+
+            // No cutting corners: a diagonal step needs land on both sides, or an animal
+            // following it from the middle of a pixel would brush the water in between
+            if (direction % 2 == 1 && (!tileLand[j * tileSize + ni] || !tileLand[nj * tileSize + i]))
+            {
+                continue;
+            }
+
+            // The way back is the opposite direction
+            reached[neighbour] = 1;
+            step[neighbour] = (direction + 4) % 8;
+            queue.push_back(neighbour);
+        }
+    }
+
+    for (int localY = 0; localY < chunkSize; localY++)
+    {
+        for (int localX = 0; localX < chunkSize; localX++)
+        {
+            int i = chunk.left + localX - tileLeft;
+            int j = chunk.top + localY - tileTop;
+
+            flow[localY * chunkSize + localX] = step[j * tileSize + i];
+        }
+    }
+}
+
+// Rebuilds a chunk's plant flow field from the plants of the loaded chunks within reach of it.
+// Only reads the world, so several chunks can be rebuilt at once.
+void computePlantFlow(Chunk &chunk)
+{
+    int tileSize = chunkSize + 2 * waterApron;
+    int tileLeft = chunk.left - waterApron;
+    int tileTop = chunk.top - waterApron;
+
+    vector<uint8_t> tileLand(tileSize * tileSize);
+
+    // Every neighbour of a loaded chunk has its land mask, loaded or not
+    for (int j = 0; j < tileSize; j++)
+    {
+        for (int i = 0; i < tileSize; i++)
+        {
+            tileLand[j * tileSize + i] = isLandInMask(tileLeft + i, tileTop + j);
+        }
+    }
+
+    vector<int> seeds;
+
+    for (int cellY = max(0, tileTop) / spatialCellSize; cellY <= min(worldHeight - 1, tileTop + tileSize - 1) / spatialCellSize; cellY++)
+    {
+        for (int cellX = max(0, tileLeft) / spatialCellSize; cellX <= min(worldWidth - 1, tileLeft + tileSize - 1) / spatialCellSize; cellX++)
+        {
+            Chunk *other = findChunk(cellX * spatialCellSize, cellY * spatialCellSize);
+
+            if (!other)
+            {
+                continue;
+            }
+
+            const vector<SpatialEntry> &bucket = spatialBucket(*other, plantLayer, cellX * spatialCellSize, cellY * spatialCellSize);
+
+            for (int e = 0; e < bucket.size(); e++)
+            {
+                int i = bucket[e].pixel.x - tileLeft;
+                int j = bucket[e].pixel.y - tileTop;
+
+                if (i >= 0 && i < tileSize && j >= 0 && j < tileSize)
+                {
+                    seeds.push_back(j * tileSize + i);
+                }
+            }
+        }
+    }
+
+    computeChunkFlow(chunk, tileLand, seeds, tileSize, chunk.plantFlow);
+    chunk.plantFlowStale = false;
+}
+
+// Marks the plant flow field of every loaded chunk within reach of the pixel as stale (a plant came or went)
+void markPlantFlowStale(int x, int y)
+{
+    int minChunkX = max(0, x - waterApron) / chunkSize;
+    int maxChunkX = min(worldWidth - 1, x + waterApron) / chunkSize;
+    int minChunkY = max(0, y - waterApron) / chunkSize;
+    int maxChunkY = min(worldHeight - 1, y + waterApron) / chunkSize;
+
+    for (int chunkY = minChunkY; chunkY <= maxChunkY; chunkY++)
+    {
+        for (int chunkX = minChunkX; chunkX <= maxChunkX; chunkX++)
+        {
+            Chunk *chunk = chunks[chunkY * chunksAcross + chunkX].get();
+
+            if (chunk)
+            {
+                chunk->plantFlowStale = true;
+            }
+        }
+    }
+}
+
+// Rebuilds (in parallel) the stale plant flow fields of the chunks animals are on, before they plan their tick
+void refreshPlantFlow()
+{
+    ProfileScope timer(profilePlantFlow);
+
+    vector<Chunk *> stale;
+
+    for (int i = 0; i < loadedChunks.size(); i++)
+    {
+        Chunk *chunk = chunks[loadedChunks[i]].get();
+
+        if (chunk->plantFlowStale && chunk->numAnimals > 0)
+        {
+            stale.push_back(chunk);
+        }
+    }
+
+    threadPool.parallelFor(stale.size(), [&](int i)
+                           { computePlantFlow(*stale[i]); }, 1);
+}
+
+// Returns the plant flow field step from the position's pixel (noFlow if no plant can be reached over land)
+uint8_t plantFlowAt(Vector2f position)
+{
+    int x = floor(position.x);
+    int y = floor(position.y);
+    Chunk *chunk = isWithinBounds(x, y) ? findChunk(x, y) : nullptr;
+
+    return chunk ? chunk->plantFlow[(y - chunk->top) * chunkSize + (x - chunk->left)] : noFlow;
+}
+
+// ------------ UTILITY FUNCTIONS ----------------
+
+// Returns true if the given coordinates are on land
+bool isLand(int x, int y)
+{
+    if (isWithinBounds(x, y))
+    {
+        Chunk *chunk = findChunk(x, y);
+
+        // Chunks that are not loaded are read from their land mask, or straight from the noise if they have none
+        if (!chunk)
+        {
+            return landMasks[(y / chunkSize) * chunksAcross + (x / chunkSize)] ? isLandInMask(x, y) : isLandInNoise(x, y);
+        }
+
+        int cell = (y - chunk->top) * chunkSize + (x - chunk->left);
+
+        return (chunk->terrainBits[cell / 64] >> (cell % 64)) & 1;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// Returns true if the given coordinates are within the bounds of the world
+bool isWithinBounds(int x, int y)
+{
+
+    return (x < worldWidth && x > 0 && y < worldHeight && y > 0);
+}
+
+// Moves an animal's blueprint and spatial index entries if it changed pixel during its tick
+void commitMove(BlueprintLayer layer, const AnimalIntent &intent, EntityHandle handle)
+{
+    ProfileScope timer(profileMove);
+
+    if (intent.fromPixel != intent.toPixel)
+    {
+        removePositionFromBlueprint(layer, intent.fromPixel.x, intent.fromPixel.y);
+        addToPositionBlueprint(layer, intent.toPixel.x, intent.toPixel.y);
+
+        removeFromSpatialIndex(layer, intent.fromPixel.x, intent.fromPixel.y, handle);
+        addToSpatialIndex(layer, intent.toPixel.x, intent.toPixel.y, handle);
+    }
+}
+
+// ------------ FUNCTIONS FOR RABBITS ------------------
+
+// add a rabbit to the simulation at given position
+void addRabbit(Vector2f position)
+{
+    int rabbit_x = floor(position.x);
+    int rabbit_y = floor(position.y);
+
+    // Random speed, and random values for thirst hunger and mating urge
+    uint64_t id = nextEntityId++;
+    RandomStream random(id, traitsTick);
+
+    float speed = rabbitSpeedMin + ((float)(random.below(1000)) / 1000) * (rabbitSpeedMax - rabbitSpeedMin);
+    float hunger = (float)(random.below((int)(rabbitMaxHunger)));
+    float thirst = (float)(random.below((int)(rabbitMaxThirst)));
+    float urge = (float)(random.below((int)(rabbitMaxReproductiveUrge)));
+
+    EntityHandle handle = rabbits.add(Vector2f(rabbit_x, rabbit_y), speed, hunger, thirst, urge, id);
+
+    // Adding the rabbit's position to the blueprint and spatial index
+    addToPositionBlueprint(rabbitLayer, rabbit_x, rabbit_y);
+    addToSpatialIndex(rabbitLayer, rabbit_x, rabbit_y, handle);
+}
+
+// Remove a rabbit from the simulation, in constant time
+void removeRabbit(EntityHandle handle)
+{
+    ProfileScope timer(profileRemove);
+
+    int index = rabbits.handles.indexOf(handle);
+
+    // Already removed
+    if (index < 0)
+    {
+        return;
+    }
+
+    int rabbit_x = floor(rabbits.position[index].x);
+    int rabbit_y = floor(rabbits.position[index].y);
+
+    removePositionFromBlueprint(rabbitLayer, rabbit_x, rabbit_y);
+    removeFromSpatialIndex(rabbitLayer, rabbit_x, rabbit_y, handle);
+
+    rabbits.removeAt(index);
+}
+
+void initializeRabbits()
+{
+    // Animals start out in the part of the world under the camera
+    IntRect spawnArea = cameraRect();
+    RandomStream spawn(spawnRabbitStream, simulationTick);
+    vector<Vector2i> land = landPixelsIn(spawnArea);
+
+    // Create rabbits and set them on land
+    // Picking straight from the land pixels, so every animal takes exactly one try (none if there is no land)
+    for (int i = 0; i < intialNumRabbits && !land.empty(); i++)
+    {
+        Vector2i pixel = land[spawn.below(land.size())];
+
+        addRabbit(Vector2f((float)pixel.x, (float)pixel.y));
+    }
+}
+
+// Calls update function of all existing rabbits (in parallel), which only plans their tick
+void updateAllRabbits()
+{
+    ProfileScope timer(profilePlanRabbits);
+
+    // Increasing hunger, thirst and reproductive urge with time (a plain loop over the arrays)
+    for (int i = 0; i < rabbits.size(); i++)
+    {
+        rabbits.hungerLevel[i] += rabbitHungerDelta;
+        rabbits.thirstLevel[i] += rabbitThirstDelta;
+        rabbits.reproductiveUrge[i] += rabbitReproductiveUrgeDelta;
+    }
+
+    rabbitIntents.resize(rabbits.size());
+
+    threadPool.parallelFor(rabbits.size(), [](int i)
+                           { rabbitIntents[i] = updateRabbit(i); });
+}
+
+// Marks the rabbit as dead for the current tick, returns false if it already was
+bool killRabbit(EntityHandle handle)
+{
+    int index = rabbits.handles.indexOf(handle);
+
+    if (index >= 0 && index < rabbitIntents.size() && !rabbitIntents[index].dies)
+    {
+        rabbitIntents[index].dies = true;
+        rabbitIntents[index].cause = diedOfPredation;
+        return true;
+    }
+
+    return false;
+}
+
+// Applies the planned ticks of all rabbits to the world in order, then drops the dead ones
+void commitAllRabbits()
+{
+    ProfileScope timer(profileCommitRabbits);
+
+    int numPlanned = rabbitIntents.size();
+    vector<EntityHandle> &dead = deadAnimals;
+    dead.clear();
+
+    for (int i = 0; i < numPlanned; i++)
+    {
+        AnimalIntent &intent = rabbitIntents[i];
+
+        // Moving everyone first, so the blueprint matches the positions of eaten rabbits too
+        commitMove(rabbitLayer, intent, rabbits.handles.at(i));
+
+        // Rabbits that came too late for the plant go hungry, and starve (where they moved to) if they were
+        // past their limit. Rabbits a wolf already caught take no bite.
+        if (intent.eatsPlant && !intent.dies)
+        {
+            if (eatPlant(intent.plantPixel))
+            {
+                rabbits.hungerLevel[i] = 0;
+            }
+            else if (rabbits.hungerLevel[i] > rabbitMaxHunger)
+            {
+                intent.dies = true;
+                intent.cause = diedOfHunger;
+            }
+        }
+
+        // Dead rabbits are removed once every index has been committed
+        if (intent.dies)
+        {
+            countDeath(tickMetrics.species[rabbitMetrics], intent.cause);
+            dead.push_back(rabbits.handles.at(i));
+            continue;
+        }
+
+        if (intent.givesBirth)
+        {
+            tickMetrics.species[rabbitMetrics].births++;
+            addRabbit(Vector2f(intent.fromPixel.x, intent.fromPixel.y));
+        }
+    }
+
+    for (int i = 0; i < dead.size(); i++)
+    {
+        removeRabbit(dead[i]);
+    }
+}
+
+// Draws all existing rabbits with a single draw call
+void drawAllRabbits(RenderWindow *window)
+{
+    ProfileScope timer(profileDrawRabbits);
+
+    // Same size the rabbit image used to be scaled to
+    Vector2f size(rabbitAtlasRect.width / 15.0 * rabbitSize, rabbitAtlasRect.height / 15.0 * rabbitSize);
+
+    rabbitVertices.resize(rabbits.size() * 4);
+
+    for (int i = 0; i < rabbits.size(); i++)
+    {
+        setQuad(rabbitVertices, i, drawnPosition(rabbits, i), size, rabbitAtlasRect);
+    }
+
+    window->draw(rabbitVertices, &atlasTexture);
+}
+
+// ------------ FUNCTIONS FOR WOLVES ------------------
+
+// Same as rabbits
+
+void addWolf(Vector2f position)
+{
+    int wolf_x = floor(position.x);
+    int wolf_y = floor(position.y);
+    // int wolf_x = floor(width / 2);
+    // int wolf_y = floor(height / 2);
+
+    uint64_t id = nextEntityId++;
+    RandomStream random(id, traitsTick);
+
+    float speed = wolfSpeedMin + ((float)(random.below(1000)) / 1000) * (wolfSpeedMax - wolfSpeedMin);
+    float hunger = (float)(random.below((int)(wolfMaxHunger)));
+    float thirst = (float)(random.below((int)(wolfMaxThirst)));
+    float urge = (float)(random.below((int)(wolfMaxReproductiveUrge)));
+
+    EntityHandle handle = wolves.add(Vector2f(wolf_x, wolf_y), speed, hunger, thirst, urge, id);
+
+    addToPositionBlueprint(wolfLayer, wolf_x, wolf_y);
+    addToSpatialIndex(wolfLayer, wolf_x, wolf_y, handle);
+}
+
+void removeWolf(EntityHandle handle)
+{
+    ProfileScope timer(profileRemove);
+
+    int index = wolves.handles.indexOf(handle);
+
+    if (index < 0)
+    {
+        return;
+    }
+
+    int wolf_x = floor(wolves.position[index].x);
+    int wolf_y = floor(wolves.position[index].y);
+
+    removePositionFromBlueprint(wolfLayer, wolf_x, wolf_y);
+    removeFromSpatialIndex(wolfLayer, wolf_x, wolf_y, handle);
+
+    wolves.removeAt(index);
+}
+
+void initializeWolves()
+{
+    IntRect spawnArea = cameraRect();
+    RandomStream spawn(spawnWolfStream, simulationTick);
+    vector<Vector2i> land = landPixelsIn(spawnArea);
+
+    // Picking straight from the land pixels, so every animal takes exactly one try (none if there is no land)
+    for (int i = 0; i < initialNumWolves && !land.empty(); i++)
+    {
+        Vector2i pixel = land[spawn.below(land.size())];
+
+        addWolf(Vector2f((float)pixel.x, (float)pixel.y));
+    }
+}
+
+void updateAllWolves()
+{
+    ProfileScope timer(profilePlanWolves);
+
+    for (int i = 0; i < wolves.size(); i++)
+    {
+        wolves.hungerLevel[i] += wolfHungerDelta;
+        wolves.thirstLevel[i] += wolfThirstDelta;
+        wolves.reproductiveUrge[i] += wolfReproductiveUrgeDelta;
+    }
+
+    wolfIntents.resize(wolves.size());
+
+    threadPool.parallelFor(wolves.size(), [](int i)
+                           { wolfIntents[i] = updateWolf(i); });
+}
+
+// Same as rabbits, plus eating the rabbits the wolves caught
+void commitAllWolves()
+{
+    ProfileScope timer(profileCommitWolves);
+
+    int numPlanned = wolfIntents.size();
+    vector<EntityHandle> &dead = deadAnimals;
+    dead.clear();
+
+    for (int i = 0; i < numPlanned; i++)
+    {
+        AnimalIntent &intent = wolfIntents[i];
+
+        // Only one wolf gets a rabbit, if two of them caught the same one. The others go
+        // hungry, and starve (where they moved to) if they were past their limit.
+        if (intent.eatsRabbit)
+        {
+            if (killRabbit(intent.prey))
+            {
+                wolves.hungerLevel[i] = 0;
+            }
+            else if (wolves.hungerLevel[i] > wolfMaxHunger)
+            {
+                intent.dies = true;
+                intent.cause = diedOfHunger;
+            }
+        }
+
+        commitMove(wolfLayer, intent, wolves.handles.at(i));
+
+        if (intent.dies)
+        {
+            countDeath(tickMetrics.species[wolfMetrics], intent.cause);
+            dead.push_back(wolves.handles.at(i));
+            continue;
+        }
+
+        if (intent.givesBirth)
+        {
+            tickMetrics.species[wolfMetrics].births++;
+            addWolf(Vector2f(intent.fromPixel.x, intent.fromPixel.y));
+        }
+    }
+
+    for (int i = 0; i < dead.size(); i++)
+    {
+        removeWolf(dead[i]);
+    }
+}
+
+void drawAllWolves(RenderWindow *window)
+{
+    ProfileScope timer(profileDrawWolves);
+
+    Vector2f size(wolfAtlasRect.width / 12.0 * wolfSize, wolfAtlasRect.height / 12.0 * wolfSize);
+
+    wolfVertices.resize(wolves.size() * 4);
+
+    for (int i = 0; i < wolves.size(); i++)
+    {
+        setQuad(wolfVertices, i, drawnPosition(wolves, i), size, wolfAtlasRect);
+    }
+
+    window->draw(wolfVertices, &atlasTexture);
+}
+
+// ------------- PLANT FUNCTIONS -----------------------
+
+// Plants are found in the spatial index by their pixel, so a plant's handle is just its pixel
+EntityHandle plantHandle(int x, int y)
+{
+    EntityHandle handle;
+    handle.slot = (uint32_t)y * worldWidth + x;
+    return handle;
+}
+
+// Radius a plant is drawn with, a fully grown one is plantSize + 0.5 and eaten ones are smaller
+float plantRadius(int biomass)
+{
+    return (plantSize + 0.5) * sqrt((float)biomass / maxPlantBiomass);
+}
+
+// Marks the pixels a plant at (x, y) can cover as changed, in every loaded chunk they are on
+void markPlantPixelsChanged(int x, int y)
+{
+    if (headless)
+    {
+        return;
+    }
+
+    int reach = ceil(plantRadius(maxPlantBiomass));
+
+    int minChunkX = max(0, x - reach) / chunkSize;
+    int maxChunkX = min(worldWidth - 1, x + reach) / chunkSize;
+    int minChunkY = max(0, y - reach) / chunkSize;
+    int maxChunkY = min(worldHeight - 1, y + reach) / chunkSize;
+
+    for (int chunkY = minChunkY; chunkY <= maxChunkY; chunkY++)
+    {
+        for (int chunkX = minChunkX; chunkX <= maxChunkX; chunkX++)
+        {
+            Chunk *chunk = chunks[chunkY * chunksAcross + chunkX].get();
+
+            if (!chunk)
+            {
+                continue;
+            }
+
+            // The plant's square, in chunk pixels and cut down to the chunk, grown into the changed rectangle
+            int left = max(0, x - reach - chunk->left);
+            int top = max(0, y - reach - chunk->top);
+            int right = min(chunkSize, x + reach + 1 - chunk->left);
+            int bottom = min(chunkSize, y + reach + 1 - chunk->top);
+
+            IntRect &changed = chunk->changedPixels;
+
+            if (changed.width > 0)
+            {
+                left = min(left, changed.left);
+                top = min(top, changed.top);
+                right = max(right, changed.left + changed.width);
+                bottom = max(bottom, changed.top + changed.height);
+            }
+
+            changed = IntRect(left, top, right - left, bottom - top);
+        }
+    }
+}
+
+// Sets the biomass of the plant on a pixel of the chunk. Plants are put in (or taken out of) the
+// blueprint and spatial index as they become food (or stop being food).
+void setPlantBiomass(Chunk &chunk, int cell, int biomass)
+{
+    int x = chunk.left + cell % chunkSize;
+    int y = chunk.top + cell / chunkSize;
 
-// To generate a terrain using perlin noise
-void generateTerrain()
+    bool wasEdible = chunk.plantBiomass[cell] >= plantEdibleBiomass;
+    bool edible = biomass >= plantEdibleBiomass;
+
+    chunk.plantBiomass[cell] = biomass;
+
+    if (edible && !wasEdible)
+    {
+        addToPositionBlueprint(plantLayer, x, y);
+        addToSpatialIndex(plantLayer, x, y, plantHandle(x, y));
+        markPlantFlowStale(x, y);
+    }
+    else if (!edible && wasEdible)
+    {
+        removePositionFromBlueprint(plantLayer, x, y);
+        removeFromSpatialIndex(plantLayer, x, y, plantHandle(x, y));
+        markPlantFlowStale(x, y);
+    }
+
+    markPlantPixelsChanged(x, y);
+}
+
+// Adds a plant with the given biomass on a pixel (of a loaded chunk) that has none yet
+void addPlant(int x, int y, int biomass)
+{
+    Chunk *chunk = isWithinBounds(x, y) ? findChunk(x, y) : nullptr;
+
+    if (!chunk)
+    {
+        return;
+    }
+
+    int cell = (y - chunk->top) * chunkSize + (x - chunk->left);
+
+    if ((chunk->plantBits[cell / 64] >> (cell % 64)) & 1)
+    {
+        return;
+    }
+
+    chunk->plantBits[cell / 64] |= 1ull << (cell % 64);
+    chunk->plantCells.push_back(cell);
+    setPlantBiomass(*chunk, cell, biomass);
+
+    if (biomass < maxPlantBiomass)
+    {
+        chunk->regrowingCells.push_back(cell);
+    }
+}
+
+// A rabbit takes a bite of the plant on the pixel, in constant time. Returns false (and nothing happens)
+// if the plant is no longer food (other rabbits got to it first this tick).
+bool eatPlant(Vector2i pixel)
 {
-    terrainTextureImage.create(width, height, sf::Color(0, 0, 0, 0));
+    Chunk *chunk = isWithinBounds(pixel.x, pixel.y) ? findChunk(pixel.x, pixel.y) : nullptr;
 
-    const siv::PerlinNoise::seed_type seed = rand();
-    const siv::PerlinNoise perlin{seed};
+    if (!chunk)
+    {
+        return false;
+    }
+
+    int cell = (pixel.y - chunk->top) * chunkSize + (pixel.x - chunk->left);
+    int biomass = chunk->plantBiomass[cell];
+
+    if (biomass < plantEdibleBiomass)
+    {
+        return false;
+    }
 
-    for (int i = 0; i < width; i++)
+    // A fully grown plant was not regrowing until now
+    if (biomass == maxPlantBiomass)
     {
-        for (int j = 0; j < height; j++)
+        chunk->regrowingCells.push_back(cell);
+    }
+
+    setPlantBiomass(*chunk, cell, max(0, biomass - plantBite));
+    return true;
+}
+
+// Grows back every plant that has been eaten. Only the regrowing plants of each chunk are looked at,
+// and they leave the list once fully grown, so the cost follows how much has been eaten.
+void regrowPlants()
+{
+    ProfileScope timer(profileRegrowPlants);
+
+    for (int i = 0; i < loadedChunks.size(); i++)
+    {
+        Chunk &chunk = *chunks[loadedChunks[i]];
+        int kept = 0;
+
+        for (int j = 0; j < chunk.regrowingCells.size(); j++)
         {
-            const double noise = perlin.octave2D_01((i * 0.01), (j * 0.01), 1, 0.2);
+            int cell = chunk.regrowingCells[j];
+            int biomass = min(maxPlantBiomass, chunk.plantBiomass[cell] + plantRegrowth);
 
-            // Values above 0.4 are land, rest are water
-            if (noise > 0.4)
+            setPlantBiomass(chunk, cell, biomass);
+
+            if (biomass < maxPlantBiomass)
             {
-                addToPositionBlueprint('l', i, j);
-                terrainTextureImage.setPixel(i, j, Color(landColorRGBA[0], landColorRGBA[1], landColorRGBA[2], landColorRGBA[3]));
+                chunk.regrowingCells[kept++] = cell;
             }
-            else
+        }
+
+        chunk.regrowingCells.resize(kept);
+    }
+}
+
+// Spawns the plants of a chunk that was just generated. They only depend on the terrain seed and the
+// chunk, so a chunk always grows the same plants, whenever it is generated.
+void spawnChunkPlants(Chunk &chunk, int chunkIndex)
+{
+    RandomStream random(chunkPlantStream + chunkIndex, 0);
+
+    // plantDensity is per 10000 pixels, the fraction left over is rounded up or down at random
+    float expectedPlants = plantDensity * (chunkSize * chunkSize) / 10000;
+    int numPlant = (int)expectedPlants;
+
+    if ((float)(random.below(1000)) / 1000 < expectedPlants - numPlant)
+    {
+        numPlant++;
+    }
+
+    for (int i = 0; i < numPlant; i++)
+    {
+        // Chunks without any land get no plants
+        Vector2i pixel = randomLandPixel(chunk, random);
+
+        if (pixel.x >= 0)
+        {
+            addPlant(pixel.x, pixel.y, maxPlantBiomass);
+        }
+    }
+}
+
+// Lets the rest of the world know the plants of a chunk that is about to be evicted are going
+// (they live in the chunk, so they go with it)
+void removeChunkPlants(Chunk &chunk)
+{
+    for (int i = 0; i < chunk.plantCells.size(); i++)
+    {
+        int x = chunk.left + chunk.plantCells[i] % chunkSize;
+        int y = chunk.top + chunk.plantCells[i] / chunkSize;
+
+        markPlantFlowStale(x, y);
+        markPlantPixelsChanged(x, y);
+    }
+}
+
+// Paints the changed rectangle of the chunk again, terrain first and then every plant that reaches
+// into it (from this chunk or a neighbour, found by their pixels around the rectangle), and sends only
+// that rectangle to the chunk's texture
+void repaintChangedPixels(Chunk &chunk)
+{
+    IntRect area = chunk.changedPixels;
+    vector<Uint8> pixels(area.width * area.height * 4);
+
+    for (int j = 0; j < area.height; j++)
+    {
+        for (int i = 0; i < area.width; i++)
+        {
+            int cell = (area.top + j) * chunkSize + area.left + i;
+            const int *colorRGBA = (chunk.terrainBits[cell / 64] >> (cell % 64)) & 1 ? landColorRGBA : waterColorRGBA;
+
+            for (int c = 0; c < 4; c++)
+            {
+                pixels[(j * area.width + i) * 4 + c] = colorRGBA[c];
+            }
+        }
+    }
+
+    // Plants are a circle with a thin dark outline
+    int reach = ceil(plantRadius(maxPlantBiomass));
+    int areaLeft = chunk.left + area.left;
+    int areaTop = chunk.top + area.top;
+
+    int minChunkX = max(0, areaLeft - reach) / chunkSize;
+    int maxChunkX = min(worldWidth - 1, areaLeft + area.width + reach) / chunkSize;
+    int minChunkY = max(0, areaTop - reach) / chunkSize;
+    int maxChunkY = min(worldHeight - 1, areaTop + area.height + reach) / chunkSize;
+
+    for (int chunkY = minChunkY; chunkY <= maxChunkY; chunkY++)
+    {
+        for (int chunkX = minChunkX; chunkX <= maxChunkX; chunkX++)
+        {
+            const Chunk *other = chunks[chunkY * chunksAcross + chunkX].get();
+
+            if (!other)
+            {
+                continue;
+            }
+
+            // Only the pixels of this chunk close enough for a plant on them to reach into the area
+            int fromX = max(0, areaLeft - reach - other->left);
+            int toX = min(chunkSize - 1, areaLeft + area.width + reach - other->left);
+            int fromY = max(0, areaTop - reach - other->top);
+            int toY = min(chunkSize - 1, areaTop + area.height + reach - other->top);
+
+            for (int localY = fromY; localY <= toY; localY++)
+            {
+                for (int localX = fromX; localX <= toX; localX++)
+                {
+                    int cell = localY * chunkSize + localX;
+
+                    if (!((other->plantBits[cell / 64] >> (cell % 64)) & 1))
+                    {
+                        continue;
+                    }
+
+                    float radius = plantRadius(other->plantBiomass[cell]);
+
+                    // Plant centre, in the area's pixels
+                    float centerX = other->left + cell % chunkSize + 0.5 - areaLeft;
+                    float centerY = other->top + cell / chunkSize + 0.5 - areaTop;
+
+                    for (int j = max(0, (int)floor(centerY - radius)); j < min(area.height, (int)ceil(centerY + radius)); j++)
+                    {
+                        for (int i = max(0, (int)floor(centerX - radius)); i < min(area.width, (int)ceil(centerX + radius)); i++)
+                        {
+                            float dx = i + 0.5 - centerX;
+                            float dy = j + 0.5 - centerY;
+                            float distance = sqrt(dx * dx + dy * dy);
+
+                            if (distance > radius)
+                            {
+                                continue;
+                            }
+
+                            Color color = distance <= radius - 1 ? Color(treeColorRGBA[0], treeColorRGBA[1], treeColorRGBA[2], treeColorRGBA[3]) : Color(0, 50, 0, 255);
+                            Uint8 *pixel = &pixels[(j * area.width + i) * 4];
+
+                            pixel[0] = color.r;
+                            pixel[1] = color.g;
+                            pixel[2] = color.b;
+                            pixel[3] = color.a;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    chunk.terrainTexture.update(pixels.data(), area.width, area.height, area.left, area.top);
+    chunk.changedPixels = IntRect();
+}
+
+// ------------- SNAPSHOT FUNCTIONS -----------------------
+
+// A snapshot holds everything needed to carry on a run exactly where it was saved. Terrain is not
+// stored since it comes from the world seed, and neither are random generators since random numbers
+// only depend on the seed, the tick and entity IDs. Layout (all little endian, arrays are raw):
+//   magic, version, world seed, world size, tick, next entity ID
+//   loaded chunks: count, then (index, last needed tick) of each, in order
+//   plants: for every loaded chunk, its plant count, plant pixels and their biomass, then its regrowing count and pixels
+//   rabbits, then wolves: count, then one array per field (position, headedTo, speed, hunger, thirst, urge, ID)
+//   spatial index: for every loaded chunk, layer and bucket, its entry count and entries in order
+//   (plants by their pixel, y * world width + x, and animals by their index)
+const char snapshotMagic[8] = {'C', 'O', 'E', 'X', 'S', 'N', 'A', 'P'};
+const uint32_t snapshotVersion = 2;
+
+// Appends count values to a snapshot as raw bytes
+template <class T>
+void writeSnapshot(vector<char> &buffer, const T *values, size_t count)
+{
+    const char *bytes = (const char *)values;
+    buffer.insert(buffer.end(), bytes, bytes + count * sizeof(T));
+}
+
+template <class T>
+void writeSnapshotValue(vector<char> &buffer, T value)
+{
+    writeSnapshot(buffer, &value, 1);
+}
+
+// Reads values back out of a snapshot, failing (for good) once it runs out of bytes
+struct SnapshotReader
+{
+    const vector<char> &buffer;
+    size_t offset = 0;
+    bool ok = true;
+
+    // Whether count more values of the given size are left, so sizes read from a broken file are never trusted
+    bool hasRoomFor(size_t count, size_t size) const
+    {
+        return ok && count <= (buffer.size() - offset) / size;
+    }
+
+    template <class T>
+    bool read(T *values, size_t count)
+    {
+        size_t bytes = count * sizeof(T);
+
+        if (!ok || buffer.size() - offset < bytes)
+        {
+            ok = false;
+            return false;
+        }
+
+        // (Empty arrays have no data pointer to copy to)
+        if (bytes > 0)
+        {
+            memcpy(values, buffer.data() + offset, bytes);
+        }
+
+        offset += bytes;
+        return true;
+    }
+
+    template <class T>
+    T value()
+    {
+        T result{};
+        read(&result, 1);
+        return result;
+    }
+};
+
+void writeAnimals(vector<char> &buffer, const AnimalStore &animals)
+{
+    uint32_t count = animals.size();
+    writeSnapshotValue(buffer, count);
+
+    writeSnapshot(buffer, animals.position.data(), count);
+    writeSnapshot(buffer, animals.headedTo.data(), count);
+    writeSnapshot(buffer, animals.speed.data(), count);
+    writeSnapshot(buffer, animals.hungerLevel.data(), count);
+    writeSnapshot(buffer, animals.thirstLevel.data(), count);
+    writeSnapshot(buffer, animals.reproductiveUrge.data(), count);
+    writeSnapshot(buffer, animals.id.data(), count);
+}
+
+// Reads animals into an empty store and puts them in the blueprint and spatial index
+bool readAnimals(SnapshotReader &reader, AnimalStore &animals, BlueprintLayer layer)
+{
+    uint32_t count = reader.value<uint32_t>();
+
+    if (!reader.hasRoomFor(count, sizeof(Vector2f)))
+    {
+        return false;
+    }
+
+    vector<Vector2f> position(count), headedTo(count);
+    vector<float> speed(count), hunger(count), thirst(count), urge(count);
+    vector<uint64_t> id(count);
+
+    reader.read(position.data(), count);
+    reader.read(headedTo.data(), count);
+    reader.read(speed.data(), count);
+    reader.read(hunger.data(), count);
+    reader.read(thirst.data(), count);
+    reader.read(urge.data(), count);
+    reader.read(id.data(), count);
+
+    if (!reader.ok)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        EntityHandle handle = animals.add(position[i], speed[i], hunger[i], thirst[i], urge[i], id[i]);
+        animals.headedTo[i] = headedTo[i];
+
+        addToPositionBlueprint(layer, floor(position[i].x), floor(position[i].y));
+        addToSpatialIndex(layer, floor(position[i].x), floor(position[i].y), handle);
+    }
+
+    return true;
+}
+
+// Writes the whole simulation to a file in one go, returns false if it could not be written
+bool saveSnapshot(const string &path)
+{
+    vector<char> buffer;
+
+    writeSnapshot(buffer, snapshotMagic, sizeof(snapshotMagic));
+    writeSnapshotValue(buffer, snapshotVersion);
+    writeSnapshotValue(buffer, worldSeed);
+    writeSnapshotValue(buffer, (int32_t)worldWidth);
+    writeSnapshotValue(buffer, (int32_t)worldHeight);
+    writeSnapshotValue(buffer, (int64_t)simulationTick);
+    writeSnapshotValue(buffer, nextEntityId);
+
+    writeSnapshotValue(buffer, (uint32_t)loadedChunks.size());
+    for (int i = 0; i < loadedChunks.size(); i++)
+    {
+        writeSnapshotValue(buffer, (int32_t)loadedChunks[i]);
+        writeSnapshotValue(buffer, (int64_t)chunks[loadedChunks[i]]->lastNeededTick);
+    }
+
+    for (int i = 0; i < loadedChunks.size(); i++)
+    {
+        const Chunk &chunk = *chunks[loadedChunks[i]];
+
+        writeSnapshotValue(buffer, (uint32_t)chunk.plantCells.size());
+        writeSnapshot(buffer, chunk.plantCells.data(), chunk.plantCells.size());
+
+        for (int j = 0; j < chunk.plantCells.size(); j++)
+        {
+            writeSnapshotValue(buffer, chunk.plantBiomass[chunk.plantCells[j]]);
+        }
+
+        writeSnapshotValue(buffer, (uint32_t)chunk.regrowingCells.size());
+        writeSnapshot(buffer, chunk.regrowingCells.data(), chunk.regrowingCells.size());
+    }
+
+    writeAnimals(buffer, rabbits);
+    writeAnimals(buffer, wolves);
+
+    // Order inside a bucket decides ties between equally near neighbours, so it is kept as it is
+    for (int i = 0; i < loadedChunks.size(); i++)
+    {
+        Chunk &chunk = *chunks[loadedChunks[i]];
+
+        for (int layer = firstOccupantLayer; layer < firstOccupantLayer + numOccupantLayers; layer++)
+        {
+            for (int cell = 0; cell < chunkSpatialCells * chunkSpatialCells; cell++)
+            {
+                const vector<SpatialEntry> &bucket = chunk.spatialIndex[layer - firstOccupantLayer][cell];
+                writeSnapshotValue(buffer, (uint32_t)bucket.size());
+
+                for (int j = 0; j < bucket.size(); j++)
+                {
+                    if (layer == plantLayer)
+                    {
+                        writeSnapshotValue(buffer, (uint32_t)bucket[j].pixel.y * worldWidth + bucket[j].pixel.x);
+                    }
+                    else
+                    {
+                        writeSnapshotValue(buffer, (uint32_t)animalsOfLayer((BlueprintLayer)layer).handles.indexOf(bucket[j].handle));
+                    }
+                }
+            }
+        }
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    return fclose(file) == 0 && written;
+}
+
+// Replaces the simulation with the one in the snapshot file, returns false if it could not be read
+bool loadSnapshot(const string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    vector<char> buffer(max(0L, size));
+    bool readAll = fread(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    fclose(file);
+
+    SnapshotReader reader{buffer};
+    char magic[sizeof(snapshotMagic)];
+
+    if (!readAll || !reader.read(magic, sizeof(magic)) || memcmp(magic, snapshotMagic, sizeof(magic)) != 0 ||
+        reader.value<uint32_t>() != snapshotVersion)
+    {
+        return false;
+    }
+
+    // The header and chunk list are checked in full before anything of the running world is touched
+    uint64_t seed = reader.value<uint64_t>();
+    int32_t snapshotWidth = reader.value<int32_t>();
+    int32_t snapshotHeight = reader.value<int32_t>();
+    int64_t tick = reader.value<int64_t>();
+    uint64_t entityId = reader.value<uint64_t>();
+
+    if (!reader.ok || !isValidWorldSize(snapshotWidth, snapshotHeight))
+    {
+        return false;
+    }
+
+    long long numChunkSlots = (long long)((snapshotWidth + chunkSize - 1) / chunkSize) * ((snapshotHeight + chunkSize - 1) / chunkSize);
+
+    // The chunks are generated again from the seed, but their plants come from the snapshot
+    uint32_t numChunks = reader.value<uint32_t>();
+
+    if (!reader.hasRoomFor(numChunks, sizeof(int32_t) + sizeof(int64_t)))
+    {
+        return false;
+    }
+
+    vector<int> chunkIndices;
+    vector<long long> chunkLastNeeded;
+    vector<bool> chunkSeen(numChunkSlots);
+
+    for (int i = 0; i < numChunks && reader.ok; i++)
+    {
+        int index = reader.value<int32_t>();
+        long long lastNeeded = reader.value<int64_t>();
+
+        if (index < 0 || index >= numChunkSlots || chunkSeen[index])
+        {
+            return false;
+        }
+
+        chunkSeen[index] = true;
+        chunkIndices.push_back(index);
+        chunkLastNeeded.push_back(lastNeeded);
+    }
+
+    worldSeed = seed;
+    worldWidth = snapshotWidth;
+    worldHeight = snapshotHeight;
+    simulationTick = tick;
+    nextEntityId = entityId;
+
+    resetWorld();
+    addChunks(chunkIndices, false);
+
+    for (int i = 0; i < chunkIndices.size(); i++)
+    {
+        Chunk &chunk = *chunks[chunkIndices[i]];
+        uint32_t numPlant = reader.value<uint32_t>();
+
+        if (!reader.hasRoomFor(numPlant, sizeof(uint16_t) + sizeof(uint8_t)))
+        {
+            return false;
+        }
+
+        vector<uint16_t> cells(numPlant);
+        vector<uint8_t> biomass(numPlant);
+        reader.read(cells.data(), numPlant);
+        reader.read(biomass.data(), numPlant);
+
+        for (int j = 0; j < numPlant; j++)
+        {
+            if (cells[j] >= chunkSize * chunkSize || biomass[j] > maxPlantBiomass)
+            {
+                return false;
+            }
+
+            addPlant(chunk.left + cells[j] % chunkSize, chunk.top + cells[j] / chunkSize, biomass[j]);
+        }
+
+        // The regrowing plants in their saved order
+        uint32_t numRegrowing = reader.value<uint32_t>();
+
+        if (!reader.hasRoomFor(numRegrowing, sizeof(uint16_t)))
+        {
+            return false;
+        }
+
+        chunk.regrowingCells.resize(numRegrowing);
+        reader.read(chunk.regrowingCells.data(), numRegrowing);
+
+        for (int j = 0; j < numRegrowing; j++)
+        {
+            if (chunk.regrowingCells[j] >= chunkSize * chunkSize)
+            {
+                return false;
+            }
+        }
+    }
+
+    if (!reader.ok || !readAnimals(reader, rabbits, rabbitLayer) || !readAnimals(reader, wolves, wolfLayer))
+    {
+        return false;
+    }
+
+    // Putting every bucket back in its saved order
+    long long animalEntries = 0;
+
+    for (int i = 0; i < chunkIndices.size(); i++)
+    {
+        Chunk &chunk = *chunks[chunkIndices[i]];
+        chunk.lastNeededTick = chunkLastNeeded[i];
+
+        for (int layer = firstOccupantLayer; layer < firstOccupantLayer + numOccupantLayers; layer++)
+        {
+            for (int cell = 0; cell < chunkSpatialCells * chunkSpatialCells; cell++)
             {
-                addToPositionBlueprint('w', i, j);
-                terrainTextureImage.setPixel(i, j, Color(waterColorRGBA[0], waterColorRGBA[1], waterColorRGBA[2], waterColorRGBA[3]));
-            }
-        }
-    }
+                vector<SpatialEntry> &bucket = chunk.spatialIndex[layer - firstOccupantLayer][cell];
+                uint32_t entries = reader.value<uint32_t>();
 
-    terrainTexture.loadFromImage(terrainTextureImage);
+                if (!reader.hasRoomFor(entries, sizeof(uint32_t)))
+                {
+                    return false;
+                }
 
-    backgroundSprite.setTexture(terrainTexture);
+                bucket.resize(entries);
 
-    terrainGenerated = true;
+                for (int j = 0; j < bucket.size(); j++)
+                {
+                    uint32_t index = reader.value<uint32_t>();
 
-    // Printing seed for the terrain generated
-    cout << "\nSeed: " << seed << endl;
-}
+                    if (layer == plantLayer)
+                    {
+                        if (!reader.ok || index >= (long long)worldWidth * worldHeight)
+                        {
+                            return false;
+                        }
 
-// ------------ POSITION BLUEPRINT FUNCTIONS ----------------
+                        int x = index % worldWidth;
+                        int y = index / worldWidth;
+                        bucket[j] = {Vector2i(x, y), plantHandle(x, y)};
+                        continue;
+                    }
 
-// Add the character to the blueprint at specific pixel
-void addToPositionBlueprint(char charIdentifier, int x, int y)
-{
-    // Adding the char to the blueprint
-    if (isWithinBounds(x, y))
-    {
-        positionBlueprint[x][y].push_back(charIdentifier);
-    }
-}
+                    AnimalStore &animals = animalsOfLayer((BlueprintLayer)layer);
 
-// Checks if the character exists in the blueprint at the specific pixel
-bool checkPositionInBlueprint(char charIdentifier, int x, int y)
-{
-    if (isWithinBounds(x, y))
-    {
-        for (int i = 0; i < positionBlueprint[x][y].size(); i++)
-        {
-            if (positionBlueprint[x][y][i] == charIdentifier)
-            {
-                return true;
+                    if (!reader.ok || index >= animals.size())
+                    {
+                        return false;
+                    }
+
+                    Vector2f position = animals.position[index];
+                    bucket[j] = {Vector2i(floor(position.x), floor(position.y)), animals.handles.at(index)};
+                    animals.bucketSlot[index] = j;
+                    animalEntries++;
+                }
             }
         }
     }
 
-    return false;
-}
+    // Every animal has to be in the bucket of its own pixel, exactly once, for removals to find it
+    if (!reader.ok || animalEntries != rabbits.size() + wolves.size())
+    {
+        return false;
+    }
 
-// Remove the character to the blueprint at specific pixel
-void removePositionFromBlueprint(char charIdentifier, int x, int y)
-{
-    if (isWithinBounds(x, y))
+    for (BlueprintLayer layer : {rabbitLayer, wolfLayer})
     {
-        int existsAt = -1;
+        AnimalStore &animals = animalsOfLayer(layer);
 
-        // Checking if charIdentifier exists on the coordinates
-        for (int i = 0; i < positionBlueprint[x][y].size(); i++)
+        for (int i = 0; i < animals.size(); i++)
         {
-            if (positionBlueprint[x][y][i] == charIdentifier)
+            int x = floor(animals.position[i].x);
+            int y = floor(animals.position[i].y);
+            Chunk *chunk = isWithinBounds(x, y) ? findChunk(x, y) : nullptr;
+
+            if (!chunk)
             {
-                existsAt = i;
-                break;
+                return false;
             }
-        }
 
-        // Removing position from blueprint if it exists
-        if (existsAt != -1)
-        {
-            vector<char>::iterator it = positionBlueprint[x][y].begin();
-            advance(it, existsAt);
+            const vector<SpatialEntry> &bucket = spatialBucket(*chunk, layer, x, y);
+            int slot = animals.bucketSlot[i];
 
-            positionBlueprint[x][y].erase(it);
+            if (slot < 0 || slot >= bucket.size() || bucket[slot].handle != animals.handles.at(i))
+            {
+                return false;
+            }
         }
     }
+
+    terrainGenerated = true;
+
+    return reader.ok;
 }
 
-// ------------ UTILITY FUNCTIONS ----------------
+// ------------- MASTER FUNCTIONS -----------------------
 
-// Returns true if the given coordinates are on land
-bool isLand(int x, int y)
+// Calls update functions of all the classes
+void masterUpdate()
 {
-    if (isWithinBounds(x, y))
-    {
-        Color thisPixel = terrainTextureImage.getPixel(x, y);
+    // Planning only reads the world, so every chunk an animal can see has to be loaded beforehand
+    int reach = max(rabbitVision, wolfVision) + 2;
 
-        return thisPixel.r == landColorRGBA[0] && thisPixel.g == landColorRGBA[1] && thisPixel.b == landColorRGBA[2] && thisPixel.a == landColorRGBA[3];
-    }
-    else
+    ProfileScope loadTimer(profileLoadChunks);
+
+    for (int i = 0; i < rabbits.size(); i++)
     {
-        return false;
+        loadChunksAround(rabbits.position[i], reach);
     }
-}
 
-// Returns true if the given coordinates are within the bounds of the screen
-bool isWithinBounds(int x, int y)
-{
+    for (int i = 0; i < wolves.size(); i++)
+    {
+        loadChunksAround(wolves.position[i], reach);
+    }
 
-    return (x < width && x > 0 && y < height && y > 0);
-}
+    loadTimer.stop();
 
-// ------------ FUNCTIONS FOR RABBITS ------------------
+    refreshPlantFlow();
 
-// add a rabbit to the simulation at given position
-void addRabbit(Vector2f position)
-{
-    int rabbit_x = floor(position.x);
-    int rabbit_y = floor(position.y);
+    // Where the animals were, so that they can be drawn moving smoothly between ticks
+    if (!headless)
+    {
+        rabbits.lastPosition = rabbits.position;
+        wolves.lastPosition = wolves.position;
+    }
 
-    // Creating a new rabbit with a pointer
-    Rabbit *rabbit = new Rabbit((rabbitSpeedMin + ((float)(rand() % 1000) / 1000) * (rabbitSpeedMax - rabbitSpeedMin)),
-                                Vector2f(1, 1),
-                                Vector2f(rabbit_x, rabbit_y),
-                                rabbitMaxHunger,
-                                rabbitMaxThirst,
-                                rabbitMaxReproductiveUrge);
+    // Every animal plans its tick from the same snapshot of the world...
+    updateAllRabbits();
+    updateAllWolves();
 
-    // Adding the rabbit's position to the blueprint
-    addToPositionBlueprint('r', floor(position.x), floor(position.y));
-    rabbits.push_back(rabbit);
-}
+    // ...then the plans are committed one by one. Wolves go first so that the
+    // rabbits they caught are eaten before those rabbits' own plans are applied.
+    commitAllWolves();
+    commitAllRabbits();
 
-// Remove a rabbit from the simulation fromt the specific point
-void removeRabbit(Vector2f position)
-{
-    // Variable to hold index of the element to remove
-    int targetAt = -1;
+    // Memory follows the population back down after a crash
+    rabbits.trim();
+    wolves.trim();
 
-    // Getting the index
-    for (int i = 0; i < rabbits.size(); i++)
+    if (rabbitIntents.capacity() > rabbits.capacity())
     {
-        if (Vector2f((float)floor(rabbits[i]->getPosition().x), (float)floor(rabbits[i]->getPosition().y)) == Vector2f((float)floor(position.x), (float)floor(position.y)))
-        {
-            targetAt = i;
-            break;
-        }
+        shrinkCapacity(rabbitIntents, rabbits.capacity());
     }
 
-    // If index is valid then remove the rabbit
-    if (targetAt >= 0 && targetAt <= rabbits.size())
+    if (wolfIntents.capacity() > wolves.capacity())
     {
-        vector<Rabbit *>::iterator it = rabbits.begin();
+        shrinkCapacity(wolfIntents, wolves.capacity());
+    }
+
+    regrowPlants();
 
-        removePositionFromBlueprint(rabbitCharIdentifier, rabbits[targetAt]->getPosition().x, rabbits[targetAt]->getPosition().y);
+    evictChunks();
 
-        advance(it, targetAt);
-        rabbits.erase(it);
+    simulationTick++;
+
+    // The tick's metrics go to the recorder's ring (--metrics FILE), and counting starts over
+    if (metricsRecorder.recording())
+    {
+        tickMetrics.tick = simulationTick;
+        measureSpecies(tickMetrics.species[rabbitMetrics], rabbits);
+        measureSpecies(tickMetrics.species[wolfMetrics], wolves);
+        metricsRecorder.record(tickMetrics);
     }
+
+    tickMetrics = {};
 }
 
-void initializeRabbits()
+// Draw everything there is to draw
+void masterDraw(RenderWindow *window)
 {
-    // Create rabbits and set them on land
-    for (int i = 0; i < intialNumRabbits; i++)
-    {
+    ProfileScope timer(profileDraw);
 
-        int rabbit_x;
-        int rabbit_y;
+    // The world is drawn through the camera
+    window->setView(camera);
 
-        // Generate coordinates until they are on land
-        do
-        {
-            rabbit_x = rand() % width;
-            rabbit_y = rand() % height;
-        } while (!isLand(rabbit_x, rabbit_y));
+    // Draw the terrain (plants are painted into it)
+    drawTerrain(window);
 
-        addRabbit(Vector2f((float)rabbit_x, (float)rabbit_y));
-    }
-}
+    // Draw the rabbits
+    drawAllRabbits(window);
 
-// Calls update function of all existing rabbits
-void updateAllRabbits()
-{
-    for (int i = 0; i < rabbits.size(); i++)
+    // Dray the wolves
+    drawAllWolves(window);
+
+    // Draw population stats (on top of the window, not the world)
+    window->setView(window->getDefaultView());
+    drawPopulationStats(window);
+
+    if (showProfile)
     {
-        rabbits[i]->update();
+        drawProfile(window);
     }
 }
 
-// Calls draw function of all existing rabbits
-void drawAllRabbits(RenderWindow *window)
+// Initializes everything that needs to be initialized, returns false if the snapshot to start from could not be loaded
+bool masterInitialize()
 {
+    threadPool.start(numThreads);
 
-    for (int i = 0; i < rabbits.size(); i++)
+    if (!headless)
     {
-        rabbits[i]->draw(window);
+        buildTextureAtlas();
     }
-}
-
-// ------------ FUNCTIONS FOR WOLVES ------------------
 
-// Same as rabbits
+    if (!loadPath.empty())
+    {
+        if (!loadSnapshot(loadPath))
+        {
+            fprintf(stderr, "Could not load snapshot %s\n", loadPath.c_str());
+            return false;
+        }
 
-void addWolf(Vector2f position)
-{
-    int wolf_x = floor(position.x);
-    int wolf_y = floor(position.y);
-    // int wolf_x = floor(width / 2);
-    // int wolf_y = floor(height / 2);
+        cerr << "\nSeed: " << worldSeed << " (snapshot at tick " << simulationTick << ")" << endl;
+        return true;
+    }
 
-    Wolf *wolf = new Wolf((wolfSpeedMin + ((float)(rand() % 1000) / 1000) * (wolfSpeedMax - wolfSpeedMin)),
-                          Vector2f(1, 1),
-                          Vector2f(wolf_x, wolf_y),
-                          wolfMaxHunger,
-                          wolfMaxThirst,
-                          wolfMaxReproductiveUrge);
+    // Plants come with the chunks, as they are generated
+    generateTerrain();
+    initializeRabbits();
+    initializeWolves();
 
-    addToPositionBlueprint(wolfCharIdentifier, floor(position.x), floor(position.y));
-    wolves.push_back(wolf);
+    return true;
 }
 
-void removeWolf(Vector2f position)
+// Saves a snapshot to savePath (or coexistence.snapshot if none was given)
+void masterSave()
 {
+    string path = savePath.empty() ? "coexistence.snapshot" : savePath;
 
-    int targetAt = -1;
-
-    for (int i = 0; i < wolves.size(); i++)
+    if (saveSnapshot(path))
     {
-        if (wolves[i]->getPosition() == position)
-        {
-            targetAt = i;
-            break;
-        }
+        fprintf(stderr, "Saved snapshot at tick %lld to %s\n", simulationTick, path.c_str());
     }
-
-    if (targetAt >= 0 && targetAt <= wolves.size())
+    else
     {
-        vector<Wolf *>::iterator it = wolves.begin();
-
-        removePositionFromBlueprint(wolfCharIdentifier, wolves[targetAt]->getPosition().x, wolves[targetAt]->getPosition().y);
-
-        advance(it, targetAt);
-        wolves.erase(it);
+        fprintf(stderr, "Could not save snapshot to %s\n", path.c_str());
     }
 }
 
-void initializeWolves()
+// Runs the simulation for a number of ticks as fast as possible without a window, then prints
+// the population of every tick as CSV on stdout and the simulation speed on stderr
+bool runHeadless(int ticks)
 {
-    for (int i = 0; i < initialNumWolves; i++)
+    if (!masterInitialize())
     {
+        return false;
+    }
 
-        int wolf_x;
-        int wolf_y;
+    long long firstTick = simulationTick;
 
-        do
-        {
-            wolf_x = rand() % width;
-            wolf_y = rand() % height;
-        } while (!isLand(wolf_x, wolf_y));
+    vector<int> rabbitPopulation;
+    vector<int> wolfPopulation;
+    rabbitPopulation.reserve(ticks);
+    wolfPopulation.reserve(ticks);
 
-        addWolf(Vector2f((float)wolf_x, (float)wolf_y));
-    }
-}
+    Clock clock;
 
-void updateAllWolves()
-{
-    for (int i = 0; i < wolves.size(); i++)
+    for (int tick = 0; tick < ticks; tick++)
     {
-        wolves[i]->update();
+        masterUpdate();
+        endProfileFrame();
+
+        rabbitPopulation.push_back(rabbits.size());
+        wolfPopulation.push_back(wolves.size());
     }
-}
 
-void drawAllWolves(RenderWindow *window)
-{
+    float elapsed = clock.getElapsedTime().asSeconds();
 
-    for (int i = 0; i < wolves.size(); i++)
+    printf("tick,rabbits,wolves\n");
+    for (int tick = 0; tick < ticks; tick++)
     {
-        wolves[i]->draw(window);
+        printf("%lld,%d,%d\n", firstTick + tick + 1, rabbitPopulation[tick], wolfPopulation[tick]);
     }
-}
-
-// ------------- PLANT FUNCTIONS -----------------------
-// Same as rabbits
-void addPlant(Vector2f position)
-{
-    Plant *plant = new Plant(position);
-
-    addToPositionBlueprint('p', floor(position.x), floor(position.y));
-    plants.push_back(plant);
-}
 
-void removePlant(Vector2f position)
-{
-    int targetAt = -1;
+    fprintf(stderr, "Simulated %d ticks in %.3f s (%.1f ticks per second)\n", ticks, elapsed, elapsed > 0 ? ticks / elapsed : 0.0f);
 
-    for (int i = 0; i < plants.size(); i++)
+    // Summary of the last ticks when profiling (the drawing phases stay at 0 without a window)
+    if (profiling)
     {
-        if (plants[i]->getPosition() == position)
+        fprintf(stderr, "%-16s %10s %10s\n", "phase", "p50 us", "p99 us");
+        for (int phase = 0; phase < profileDraw; phase++)
         {
-            targetAt = i;
-            break;
+            fprintf(stderr, "%-16s %10lld %10lld\n", profilePhaseNames[phase], (long long)profilePercentile((ProfilePhase)phase, 50), (long long)profilePercentile((ProfilePhase)phase, 99));
         }
     }
 
-    if (targetAt >= 0 && targetAt <= plants.size())
+    if (!savePath.empty())
     {
-        vector<Plant *>::iterator it = plants.begin();
-
-        advance(it, targetAt);
-
-        plants.erase(it);
-
-        removePositionFromBlueprint('p', position.x, position.y);
+        masterSave();
     }
+
+    return true;
 }
 
-void initializePlant()
+// Reads a whole positive number into value, returns false (leaving value alone) for anything else
+bool parsePositiveInt(const char *text, int &value)
 {
-    int numPlant = (int)(plantDensity * (width * height) / 10000);
+    char *end;
+    errno = 0;
+    long number = strtol(text, &end, 10);
 
-    for (int i = 0; i < (int)(numPlant); i++)
+    if (end == text || *end != '\0' || errno == ERANGE || number <= 0 || number > INT_MAX)
     {
-        int plant_x;
-        int plant_y;
-
-        do
-        {
-            plant_x = rand() % width;
-            plant_y = rand() % height;
-        } while (!isLand(plant_x, plant_y));
-
-        addPlant(Vector2f((float)plant_x, (float)plant_y));
+        return false;
     }
+
+    value = number;
+    return true;
 }
 
-void drawAllPlants(RenderWindow *window)
+// Reads a whole unsigned 64-bit number into value, returns false (leaving value alone) for anything else
+bool parseSeed(const char *text, uint64_t &value)
 {
-    for (int i = 0; i < plants.size(); i++)
+    // strtoull would quietly negate a leading minus sign
+    if (!isdigit((unsigned char)text[0]))
     {
-        plants[i]->draw(window);
+        return false;
     }
-}
 
-// ------------- MASTER FUNCTIONS -----------------------
+    char *end;
+    errno = 0;
+    unsigned long long number = strtoull(text, &end, 10);
 
-// Calls update functions of all the classes
-void masterUpdate()
-{
-    updateAllRabbits();
-    updateAllWolves();
+    if (*end != '\0' || errno == ERANGE)
+    {
+        return false;
+    }
 
-    fprintf(stderr, "Rabbits Alive: %ld Wolves Alive: %ld\n", rabbits.size(), wolves.size());
+    value = number;
+    return true;
 }
 
-// Draw everything there is to draw
-void masterDraw(RenderWindow *window)
+int main(int argc, char *argv[])
 {
-    // Draw the terrain
-    window->draw(backgroundSprite);
-
-    // Draw the rabbits
-    drawAllRabbits(window);
-
-    // Dray the wolves
-    drawAllWolves(window);
+    // A different world every run, unless a seed is given
+    worldSeed = time(NULL);
 
-    // Draw the plants
-    drawAllPlants(window);
-
-    // Draw population stats
-    drawPopulationStats(window);
-}
+    // Reading command line options
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
 
-// Initializes everything that needs to be initialized
-void masterInitialize()
-{
+        if (option == "--headless")
+        {
+            headless = true;
+        }
+        // (Anything but a whole positive number falls through to the usage line)
+        else if (option == "--ticks" && i + 1 < argc && parsePositiveInt(argv[i + 1], headlessTicks))
+        {
+            i++;
+        }
+        else if (option == "--threads" && i + 1 < argc && parsePositiveInt(argv[i + 1], numThreads))
+        {
+            i++;
+        }
+        else if (option == "--seed" && i + 1 < argc && parseSeed(argv[i + 1], worldSeed))
+        {
+            i++;
+        }
+        else if (option == "--load" && i + 1 < argc)
+        {
+            loadPath = argv[++i];
+        }
+        else if (option == "--save" && i + 1 < argc)
+        {
+            savePath = argv[++i];
+        }
+        else if (option == "--profile" && i + 1 < argc)
+        {
+            if (!openProfileFile(argv[++i]))
+            {
+                fprintf(stderr, "Could not open profile file %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (option == "--metrics" && i + 1 < argc)
+        {
+            if (!metricsRecorder.open(argv[++i]))
+            {
+                fprintf(stderr, "Could not open metrics file %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (option == "--world" && i + 2 < argc && parsePositiveInt(argv[i + 1], worldWidth) && parsePositiveInt(argv[i + 2], worldHeight))
+        {
+            i += 2;
 
-    generateTerrain();
-    initializeRabbits();
-    initializeWolves();
-    initializePlant();
-}
+            if (!isValidWorldSize(worldWidth, worldHeight))
+            {
+                fprintf(stderr, "The world has to be at least %dx%d pixels (the window) and at most %lld pixels\n", width, height, maxWorldPixels);
+                return 1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--headless] [--ticks N] [--threads N] [--world W H] [--seed N] [--load FILE] [--save FILE] [--profile FILE] [--metrics FILE]\n", argv[0]);
+            return 1;
+        }
+    }
 
-int main()
-{
-    // Initializing random module
-    srand(time(NULL));
+    if (headless)
+    {
+        return runHeadless(headlessTicks) ? 0 : 1;
+    }
 
     RenderWindow window(VideoMode(width, height), "Co-existence");
     RectangleShape blackScreen(Vector2f(width, height));
@@ -1183,16 +4192,23 @@ int main()
     int blackScreenAlpha = 255;
 
     // Initializing everything
-    masterInitialize();
+    if (!masterInitialize())
+    {
+        return 1;
+    }
 
     // not redrawing same stuff
     window.setKeyRepeatEnabled(false);
 
-    // Keeping framerate constant
-    window.setFramerateLimit(frameRate);
+    // Drawing at the display's refresh rate, the simulation keeps its own pace
+    window.setVerticalSyncEnabled(true);
 
     displayLoadingScreen(&window);
 
+    // Ticks owed to the simulation (whole ones are run before every frame, the fraction left is drawn)
+    Clock frameClock;
+    double owedTicks = 0;
+
     while (window.isOpen())
     {
 
@@ -1204,12 +4220,39 @@ int main()
                 window.close();
             }
 
+            // F5 saves a snapshot of the simulation
+            if (!onIntro && event.type == Event::KeyPressed && event.key.code == Keyboard::F5)
+            {
+                masterSave();
+            }
+
+            // F3 shows or hides the profile overlay
+            if (!onIntro && event.type == Event::KeyPressed && event.key.code == Keyboard::F3)
+            {
+                showProfile = !showProfile;
+                updateProfiling();
+            }
+
+            // - and + slow down and speed up the simulation
+            if (!onIntro && event.type == Event::KeyPressed)
+            {
+                if (event.key.code == Keyboard::Hyphen || event.key.code == Keyboard::Subtract)
+                {
+                    speedLevel = max(0, speedLevel - 1);
+                }
+                else if (event.key.code == Keyboard::Equal || event.key.code == Keyboard::Add)
+                {
+                    speedLevel = min(numSimulationSpeeds - 1, speedLevel + 1);
+                }
+            }
+
             // If spacebar pressed on intro then move on from intro
             if (onIntro && event.type == sf::Event::EventType::KeyPressed)
             {
                 if (event.key.code == sf::Keyboard::Enter)
                 {
                     onIntro = false;
+                    frameClock.restart();
                 }
             }
         }
@@ -1233,8 +4276,49 @@ int main()
                 blackScreenAlpha = 0;
             }
 
-            // Update everything
-            masterUpdate();
+            // Arrow keys (or WASD) move the camera around the world
+            float cameraX = 0;
+            float cameraY = 0;
+
+            if (Keyboard::isKeyPressed(Keyboard::Left) || Keyboard::isKeyPressed(Keyboard::A))
+            {
+                cameraX -= cameraSpeed;
+            }
+            if (Keyboard::isKeyPressed(Keyboard::Right) || Keyboard::isKeyPressed(Keyboard::D))
+            {
+                cameraX += cameraSpeed;
+            }
+            if (Keyboard::isKeyPressed(Keyboard::Up) || Keyboard::isKeyPressed(Keyboard::W))
+            {
+                cameraY -= cameraSpeed;
+            }
+            if (Keyboard::isKeyPressed(Keyboard::Down) || Keyboard::isKeyPressed(Keyboard::S))
+            {
+                cameraY += cameraSpeed;
+            }
+
+            moveCamera(cameraX, cameraY);
+
+            // Update everything, as many ticks as the time since the last frame is worth at this speed
+            float frameTime = frameClock.restart().asSeconds();
+            owedTicks += (double)frameTime * ticksPerSecond * simulationSpeeds[speedLevel];
+
+            Clock updateClock;
+
+            while (owedTicks >= 1)
+            {
+                masterUpdate();
+                owedTicks -= 1;
+
+                // When the ticks take longer than a frame, the ones that did not fit are skipped so the window stays responsive
+                if (updateClock.getElapsedTime().asSeconds() > 1.0f / frameRate)
+                {
+                    owedTicks -= floor(owedTicks);
+                    break;
+                }
+            }
+
+            tickFraction = owedTicks;
 
             window.clear();
 
@@ -1248,6 +4332,8 @@ int main()
 
         // Display everything
         window.display();
+
+        endProfileFrame();
     }
 
     // BAS HOGAYAAAAAAAAAAAAAAAAAAAA
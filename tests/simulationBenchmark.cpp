@@ -0,0 +1,379 @@
+// Microbenchmarks for the hot paths of the simulation, reporting the time per operation and items per second
+// of each one (in the spirit of Google Benchmark, without needing it). It pulls main.cpp in whole so it
+// measures exactly the code the game runs. Build it from the repository root the same way as the game:
+//
+//   g++ -std=c++17 -O2 tests/simulationBenchmark.cpp -o simulationBenchmark -lsfml-graphics -lsfml-window -lsfml-system -pthread
+//
+// and run it with ./simulationBenchmark [--filter TEXT] [--min-time SECONDS] [--threads N]
+
+#define main coexistenceMain
+#include "../main.cpp"
+#undef main
+
+#include <filesystem>
+
+// Every benchmark runs for at least this long (--min-time SECONDS)
+double minBenchmarkSeconds = 0.5;
+
+// Only benchmarks with this in their name are run (--filter TEXT)
+string benchmarkFilter;
+
+// Results are added to this so the compiler cannot drop the work being measured
+volatile long long benchmarkSink = 0;
+
+// Handed to every benchmark: run the operation iterations times, and count the items it went through.
+// Setup that should not be measured goes between pauseTiming and resumeTiming.
+struct BenchmarkState
+{
+    long long iterations = 1;
+    long long items = 0;
+
+    chrono::steady_clock::duration paused{};
+    chrono::steady_clock::time_point pausedAt;
+
+    void pauseTiming()
+    {
+        pausedAt = chrono::steady_clock::now();
+    }
+
+    void resumeTiming()
+    {
+        paused += chrono::steady_clock::now() - pausedAt;
+    }
+};
+
+// Runs the benchmark with twice as many iterations every time until a run lasts minBenchmarkSeconds,
+// then prints its time per iteration and the items it went through per second
+void runBenchmark(const string &name, const function<void(BenchmarkState &)> &body)
+{
+    if (name.find(benchmarkFilter) == string::npos)
+    {
+        return;
+    }
+
+    for (long long iterations = 1;; iterations *= 2)
+    {
+        BenchmarkState state;
+        state.iterations = iterations;
+
+        auto start = chrono::steady_clock::now();
+        body(state);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start - state.paused).count();
+
+        if (seconds >= minBenchmarkSeconds || iterations >= (1ll << 40))
+        {
+            printf("%-36s %14.1f ns/op %12lld iterations %14.4g items/s\n", name.c_str(), seconds * 1e9 / iterations,
+                   iterations, seconds > 0 ? state.items / seconds : 0.0);
+            fflush(stdout);
+            return;
+        }
+    }
+}
+
+// Starts an empty world of the given size with every chunk loaded (plants included)
+void loadWholeWorld(int worldW, int worldH)
+{
+    worldWidth = worldW;
+    worldHeight = worldH;
+    simulationTick = 0;
+
+    resetWorld();
+    loadChunksIn(0, 0, worldWidth - 1, worldHeight - 1);
+}
+
+// ------------ BENCHMARKS ----------------
+
+void benchmarkBlueprint()
+{
+    loadWholeWorld(width, height);
+    initializeRabbits();
+    initializeWolves();
+
+    // The same random pixels every run
+    RandomStream random(spawnRabbitStream, 0);
+    vector<Vector2i> pixels(4096);
+
+    for (int i = 0; i < pixels.size(); i++)
+    {
+        pixels[i] = Vector2i(random.below(worldWidth), random.below(worldHeight));
+    }
+
+    runBenchmark("checkPositionInBlueprint", [&](BenchmarkState &state)
+    {
+        long long found = 0;
+
+        for (long long i = 0; i < state.iterations; i++)
+        {
+            Vector2i pixel = pixels[i % pixels.size()];
+            found += checkPositionInBlueprint((BlueprintLayer)(i % (wolfLayer + 1)), pixel.x, pixel.y);
+        }
+
+        benchmarkSink += found;
+        state.items = state.iterations;
+    });
+}
+
+// What every animal does at the start of its tick: the nearest food, mate and water within its vision
+void benchmarkScan()
+{
+    loadWholeWorld(width, height);
+
+    int oldRabbits = intialNumRabbits;
+    intialNumRabbits = 2000;
+    initializeRabbits();
+    intialNumRabbits = oldRabbits;
+
+    vector<Vector2f> positions = rabbits.position;
+
+    for (int vision : {10, 30, 60, 120})
+    {
+        runBenchmark("scanSurroundings/vision:" + to_string(vision), [&](BenchmarkState &state)
+        {
+            float found = 0;
+
+            for (long long i = 0; i < state.iterations; i++)
+            {
+                Vector2f position = positions[i % positions.size()];
+
+                found += findNearestInSpatialIndex(plantLayer, position, vision, false).x;
+                found += findNearestInSpatialIndex(rabbitLayer, position, vision, true).x;
+                found += findNearestWater(position, vision).x;
+            }
+
+            benchmarkSink += found;
+            state.items = state.iterations;
+        });
+    }
+}
+
+void benchmarkTerrain()
+{
+    int sizes[][2] = {{width, height}, {1920, 1080}, {2048, 2048}};
+
+    for (auto &size : sizes)
+    {
+        string name = "generateTerrain/" + to_string(size[0]) + "x" + to_string(size[1]);
+
+        runBenchmark(name, [&](BenchmarkState &state)
+        {
+            for (long long i = 0; i < state.iterations; i++)
+            {
+                loadWholeWorld(size[0], size[1]);
+            }
+
+            state.items = state.iterations * size[0] * size[1];
+        });
+    }
+}
+
+void benchmarkNoise()
+{
+    siv::PerlinNoise noise(1234);
+
+    runBenchmark("octave2D_01/scalar", [&](BenchmarkState &state)
+    {
+        double sum = 0;
+
+        for (long long i = 0; i < state.iterations; i++)
+        {
+            sum += noise.octave2D_01((i % 4096) * 0.01, (i / 4096) * 0.01, 1, 0.2);
+        }
+
+        benchmarkSink += (long long)sum;
+        state.items = state.iterations;
+    });
+
+    // One operation is a whole row of samples here
+    vector<double> row(4096);
+
+    runBenchmark("octave2D_01/fillRow2D:4096", [&](BenchmarkState &state)
+    {
+        for (long long i = 0; i < state.iterations; i++)
+        {
+            noise.fillRow2D(0, 0.01, i * 0.01, row.size(), 1, 0.2, row.data());
+        }
+
+        benchmarkSink += (long long)row[0];
+        state.items = state.iterations * row.size();
+    });
+}
+
+// Adding and removing count animals of one species, every operation is the whole population
+void benchmarkAddRemove(const string &species, AnimalStore &animals, void (*addAnimal)(Vector2f), void (*removeAnimal)(EntityHandle))
+{
+    loadWholeWorld(width, height);
+
+    vector<Vector2i> land = landPixelsIn(IntRect(0, 0, worldWidth, worldHeight));
+
+    for (int count : {100, 10000, 1000000})
+    {
+        // The land pixels the animals go on, and the order they are removed in (both the same every run)
+        RandomStream random(spawnRabbitStream, count);
+        vector<Vector2f> spots(count);
+        vector<int> removeOrder(count);
+
+        for (int i = 0; i < count; i++)
+        {
+            Vector2i pixel = land[random.below(land.size())];
+            spots[i] = Vector2f(pixel.x, pixel.y);
+            removeOrder[i] = i;
+        }
+
+        for (int i = count - 1; i > 0; i--)
+        {
+            swap(removeOrder[i], removeOrder[random.below(i + 1)]);
+        }
+
+        vector<EntityHandle> handles(count);
+
+        auto addAll = [&]()
+        {
+            for (int i = 0; i < count; i++)
+            {
+                addAnimal(spots[i]);
+            }
+        };
+
+        auto removeAll = [&]()
+        {
+            for (int i = 0; i < count; i++)
+            {
+                handles[i] = animals.handles.at(i);
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                removeAnimal(handles[removeOrder[i]]);
+            }
+        };
+
+        runBenchmark("add" + species + "/" + to_string(count), [&](BenchmarkState &state)
+        {
+            for (long long i = 0; i < state.iterations; i++)
+            {
+                addAll();
+
+                state.pauseTiming();
+                removeAll();
+                state.resumeTiming();
+            }
+
+            state.items = state.iterations * count;
+        });
+
+        runBenchmark("remove" + species + "/" + to_string(count), [&](BenchmarkState &state)
+        {
+            for (long long i = 0; i < state.iterations; i++)
+            {
+                state.pauseTiming();
+                addAll();
+                state.resumeTiming();
+
+                removeAll();
+            }
+
+            state.items = state.iterations * count;
+        });
+    }
+}
+
+// Ticks of the default world, starting with more and more animals. Every operation runs the same
+// benchmarkTicks ticks from the same saved starting point (restored, plant flow field included,
+// outside the timing), so the numbers do not depend on how many iterations were run. Items are animals updated.
+const int benchmarkTicks = 10;
+
+void benchmarkTick()
+{
+    int oldRabbits = intialNumRabbits;
+    int oldWolves = initialNumWolves;
+    // The starting point lives in the temporary directory, not wherever the benchmark is run from
+    error_code error;
+    filesystem::path tempDirectory = filesystem::temp_directory_path(error);
+    string snapshotPath = (error ? filesystem::path(".") : tempDirectory) / "simulationBenchmark.snapshot";
+
+    for (int count : {30, 1000, 10000})
+    {
+        loadWholeWorld(width, height);
+
+        intialNumRabbits = count;
+        initialNumWolves = count * 2 / 3;
+        initializeRabbits();
+        initializeWolves();
+
+        if (!saveSnapshot(snapshotPath))
+        {
+            fprintf(stderr, "Could not save the starting point to %s\n", snapshotPath.c_str());
+            break;
+        }
+
+        runBenchmark("masterUpdate/rabbits:" + to_string(count) + "/ticks:" + to_string(benchmarkTicks), [&](BenchmarkState &state)
+        {
+            for (long long i = 0; i < state.iterations; i++)
+            {
+                state.pauseTiming();
+
+                if (!loadSnapshot(snapshotPath))
+                {
+                    fprintf(stderr, "Could not load the starting point from %s\n", snapshotPath.c_str());
+                    remove(snapshotPath.c_str());
+                    exit(1);
+                }
+
+                refreshPlantFlow();
+                state.resumeTiming();
+
+                for (int tick = 0; tick < benchmarkTicks; tick++)
+                {
+                    state.items += rabbits.size() + wolves.size();
+                    masterUpdate();
+                }
+            }
+        });
+    }
+
+    remove(snapshotPath.c_str());
+
+    intialNumRabbits = oldRabbits;
+    initialNumWolves = oldWolves;
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+
+        if (option == "--filter" && i + 1 < argc)
+        {
+            benchmarkFilter = argv[++i];
+        }
+        else if (option == "--min-time" && i + 1 < argc)
+        {
+            minBenchmarkSeconds = atof(argv[++i]);
+        }
+        else if (option == "--threads" && i + 1 < argc && parsePositiveInt(argv[i + 1], numThreads))
+        {
+            i++;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--filter TEXT] [--min-time SECONDS] [--threads N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Nothing is drawn, and every run is the same world
+    headless = true;
+    worldSeed = 42;
+    threadPool.start(numThreads);
+
+    benchmarkBlueprint();
+    benchmarkScan();
+    benchmarkTerrain();
+    benchmarkNoise();
+    benchmarkAddRemove("Rabbits", rabbits, addRabbit, removeRabbit);
+    benchmarkAddRemove("Wolves", wolves, addWolf, removeWolf);
+    benchmarkTick();
+
+    return 0;
+}